@@ -0,0 +1,130 @@
+/* Decodificadores de audio para las respuestas del servidor
+
+   Formatos (código de formato WAV):
+   - 0x0001 PCM 16 bits:  sin compresión
+   - 0x0007 µ-law G.711:  8 bits por muestra (2:1 frente a PCM16)
+   - 0x0011 IMA ADPCM:    4 bits por muestra (~4:1 frente a PCM16)
+
+   Todo se decodifica por bloques sobre buffers del llamador, sin memoria
+   dinámica, para alimentar la reproducción I2S a medida que se lee la SD.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_MULAW 0x0007
+#define WAVE_FORMAT_IMA_ADPCM 0x0011
+
+// Formatos que B sabe reproducir, anunciados al servidor en la subida
+#define AUDIO_ACCEPT "audio/wav;codec=ima-adpcm, audio/wav;codec=mulaw, audio/wav"
+
+// ========== µ-LAW ==========
+inline int16_t mulawDecode(uint8_t u)
+{
+    u = ~u;
+    int32_t t = (((int32_t)(u & 0x0F) << 3) + 0x84) << ((u & 0x70) >> 4);
+    return (int16_t)((u & 0x80) ? (0x84 - t) : (t - 0x84));
+}
+
+// Decodifica `count` bytes µ-law a PCM16. `in` y `out` no deben solaparse.
+inline void decodeMulaw(const uint8_t *in, int count, int16_t *out)
+{
+    for (int i = 0; i < count; i++)
+    {
+        out[i] = mulawDecode(in[i]);
+    }
+}
+
+// ========== IMA ADPCM ==========
+static const int16_t imaStepTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31,
+    34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143,
+    157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+    724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024,
+    3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static const int8_t imaIndexTable[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8};
+
+struct ImaState
+{
+    int32_t predictor;
+    int32_t index;
+};
+
+inline int16_t imaDecodeNibble(ImaState &st, uint8_t nibble)
+{
+    int32_t step = imaStepTable[st.index];
+    int32_t diff = step >> 3;
+    if (nibble & 1)
+        diff += step >> 2;
+    if (nibble & 2)
+        diff += step >> 1;
+    if (nibble & 4)
+        diff += step;
+
+    st.predictor += (nibble & 8) ? -diff : diff;
+    if (st.predictor > 32767)
+        st.predictor = 32767;
+    if (st.predictor < -32768)
+        st.predictor = -32768;
+
+    st.index += imaIndexTable[nibble];
+    if (st.index < 0)
+        st.index = 0;
+    if (st.index > 88)
+        st.index = 88;
+
+    return (int16_t)st.predictor;
+}
+
+// Muestras por canal que produce un bloque completo de `blockAlign` bytes
+inline int imaSamplesPerBlock(int blockAlign, int channels)
+{
+    return (blockAlign - 4 * channels) * 2 / channels + 1;
+}
+
+// Decodifica un bloque IMA ADPCM de WAV (mono o estéreo) a PCM16 entrelazado.
+// `blockSize` puede ser menor que blockAlign en el último bloque del archivo.
+// `out` necesita espacio para imaSamplesPerBlock(blockSize, channels) * channels.
+// Devuelve las muestras por canal escritas, o 0 si el bloque es inválido.
+inline int decodeImaAdpcmBlock(const uint8_t *block, int blockSize, int channels, int16_t *out)
+{
+    if (channels < 1 || channels > 2 || blockSize < 4 * channels)
+        return 0;
+
+    // Cabecera por canal: predictor (int16 LE), índice de paso, reservado
+    ImaState st[2];
+    for (int ch = 0; ch < channels; ch++)
+    {
+        const uint8_t *h = block + ch * 4;
+        st[ch].predictor = (int16_t)(h[0] | (h[1] << 8));
+        st[ch].index = h[2] > 88 ? 88 : h[2];
+        out[ch] = (int16_t)st[ch].predictor;
+    }
+
+    // Datos: grupos de 4 bytes (8 muestras) alternando canales, nibble bajo primero
+    const uint8_t *data = block + 4 * channels;
+    int groups = (blockSize - 4 * channels) / (4 * channels);
+
+    for (int g = 0; g < groups; g++)
+    {
+        for (int ch = 0; ch < channels; ch++)
+        {
+            const uint8_t *bytes = data + (g * channels + ch) * 4;
+            int16_t *dst = out + (1 + g * 8) * channels + ch;
+
+            for (int b = 0; b < 4; b++)
+            {
+                dst[(b * 2) * channels] = imaDecodeNibble(st[ch], bytes[b] & 0x0F);
+                dst[(b * 2 + 1) * channels] = imaDecodeNibble(st[ch], bytes[b] >> 4);
+            }
+        }
+    }
+
+    return 1 + groups * 8;
+}
@@ -0,0 +1,148 @@
+/* Configuración de audio compartida por ESP32 A y ESP32 B
+
+   El formato se elige en platformio.ini con AUDIO_SAMPLE_RATE (8000, 16000
+   o 24000) y AUDIO_BITS (16 o 24). Los dos entornos (capture y processor)
+   toman los mismos flags de la sección [audio], así que ambos nodos se
+   compilan siempre con el mismo formato. Además A envía el formato en el
+   comando START y B rechaza grabaciones que no coinciden.
+
+   Todo se resuelve en compilación: las rutas de captura y reproducción se
+   especializan por plantilla y no hay coste en tiempo de ejecución.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include "driver/i2s.h"
+
+#ifndef AUDIO_SAMPLE_RATE
+#define AUDIO_SAMPLE_RATE 16000
+#endif
+
+#ifndef AUDIO_BITS
+#define AUDIO_BITS 16
+#endif
+
+// ========== ENLACE A ↔ B ==========
+constexpr int LINK_BAUD = 921600;
+constexpr int LINK_TX_BUFFER = 12288;    // Buffer TX del UART en A
+constexpr int LINK_RX_BUFFER = 24576;    // Buffer RX del enlace en B
+constexpr uint32_t CHUNK_PERIOD_MS = 128; // Duración de cada chunk de captura
+
+// Protocolo: "START <hz>/<bits>\n", datos, "STOP\n"
+#define LINK_CMD_START "START"
+#define LINK_CMD_STOP "STOP\n"
+// Comando más largo: B guarda los últimos LINK_CMD_MAX_LEN - 1 bytes de cada
+// lectura para encontrar los comandos partidos entre dos lecturas
+constexpr size_t LINK_CMD_MAX_LEN = sizeof(LINK_CMD_START " 24000/24\n") - 1;
+
+// ========== FRECUENCIA DE MUESTREO ==========
+// Solo existen especializaciones para las frecuencias soportadas
+template <uint32_t Rate>
+struct RateTraits;
+
+// Polo del HPF de captura para un corte de ~13 Hz
+template <>
+struct RateTraits<8000>
+{
+    static constexpr int32_t hpfCoeffQ15 = 32441;
+};
+
+template <>
+struct RateTraits<16000>
+{
+    static constexpr int32_t hpfCoeffQ15 = 32604;
+};
+
+template <>
+struct RateTraits<24000>
+{
+    static constexpr int32_t hpfCoeffQ15 = 32658;
+};
+
+// ========== RESOLUCIÓN ==========
+template <uint8_t Bits>
+struct SampleTraits;
+
+template <>
+struct SampleTraits<16>
+{
+    static constexpr uint8_t bytesPerSample = 2;
+    static constexpr int micShift = 14;   // I2S 32 bits → 16 bits con ganancia x4
+    static constexpr uint8_t levelShift = 0; // Escala de niveles frente a 16 bits
+    static constexpr i2s_bits_per_sample_t speakerBits = I2S_BITS_PER_SAMPLE_16BIT;
+    typedef int16_t Slot; // Muestra I2S de la bocina
+
+    // Empaqueta muestras ya procesadas para el enlace (int16 LE)
+    static void pack(const int32_t *in, uint8_t *out, int n)
+    {
+        int16_t *dst = (int16_t *)out;
+        for (int i = 0; i < n; i++)
+        {
+            int32_t s = in[i];
+            if (s > 32767)
+                s = 32767;
+            if (s < -32768)
+                s = -32768;
+            dst[i] = (int16_t)s;
+        }
+    }
+
+    static inline Slot toSlot(int16_t s) { return s; }
+};
+
+template <>
+struct SampleTraits<24>
+{
+    static constexpr uint8_t bytesPerSample = 3;
+    static constexpr int micShift = 6;
+    static constexpr uint8_t levelShift = 8;
+    // MAX98357A: 24 bits útiles en slots de 32 bits
+    static constexpr i2s_bits_per_sample_t speakerBits = I2S_BITS_PER_SAMPLE_32BIT;
+    typedef int32_t Slot;
+
+    // Empaqueta a 24 bits LE (3 bytes por muestra)
+    static void pack(const int32_t *in, uint8_t *out, int n)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            int32_t s = in[i];
+            if (s > 8388607)
+                s = 8388607;
+            if (s < -8388608)
+                s = -8388608;
+            out[i * 3] = s & 0xFF;
+            out[i * 3 + 1] = (s >> 8) & 0xFF;
+            out[i * 3 + 2] = (s >> 16) & 0xFF;
+        }
+    }
+
+    static inline Slot toSlot(int16_t s) { return (int32_t)s << 16; }
+};
+
+// ========== FORMATO COMPLETO ==========
+template <uint32_t Rate, uint8_t Bits>
+struct AudioFormat : RateTraits<Rate>, SampleTraits<Bits>
+{
+    static constexpr uint32_t sampleRate = Rate;
+    static constexpr uint8_t bitsPerSample = Bits;
+    static constexpr uint32_t samplesPerChunk = Rate * CHUNK_PERIOD_MS / 1000;
+    static constexpr size_t chunkBytes = samplesPerChunk * SampleTraits<Bits>::bytesPerSample;
+    static constexpr uint32_t bytesPerSecond = Rate * SampleTraits<Bits>::bytesPerSample;
+
+    static_assert(samplesPerChunk * 1000 == Rate * CHUNK_PERIOD_MS,
+                  "El chunk debe tener un número entero de muestras");
+};
+
+typedef AudioFormat<AUDIO_SAMPLE_RATE, AUDIO_BITS> Audio;
+
+constexpr uint32_t SAMPLE_RATE = Audio::sampleRate;
+constexpr uint32_t SAMPLES_PER_CHUNK = Audio::samplesPerChunk;
+
+// 10 bits por byte en el UART (start + 8 + stop), con 25% de margen
+static_assert(LINK_BAUD / 10 >= Audio::bytesPerSecond * 5 / 4,
+              "LINK_BAUD no alcanza para AUDIO_SAMPLE_RATE/AUDIO_BITS");
+static_assert(Audio::chunkBytes <= (size_t)LINK_TX_BUFFER,
+              "Un chunk de captura no cabe en el buffer TX del enlace");
+static_assert(Audio::bytesPerSecond * CHUNK_PERIOD_MS / 1000 * 2 <= (uint32_t)LINK_RX_BUFFER,
+              "El buffer RX de B debe guardar al menos dos chunks");
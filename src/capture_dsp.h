@@ -0,0 +1,330 @@
+/* Cadena DSP de captura en punto fijo (ESP32 A)
+
+   Etapas, en orden, sobre cada chunk de muestras int32 (in place):
+   1. HPF:  filtro pasa-altas de un polo que elimina el offset DC del INMP441
+   2. Gate: compuerta de ruido con envolvente, retención y rampa de ganancia
+   3. AGC:  control automático de ganancia por chunk + limitador por muestra
+
+   Cada etapa mide sus ciclos. Si el coste del chunk supera el presupuesto
+   (una fracción del tiempo real del chunk), se desactivan etapas empezando
+   por la de menor prioridad (AGC → Gate → HPF) y se reactivan cuando la
+   estimación vuelve a caber con margen.
+
+   No depende de Arduino: el contador de ciclos se pasa a dspInit() para
+   poder compilar y probar la cadena en el host (test/test_capture_dsp).
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+
+#define DSP_STAGE_HPF 0x01
+#define DSP_STAGE_GATE 0x02
+#define DSP_STAGE_AGC 0x04
+#define DSP_STAGE_COUNT 3
+
+#define DSP_RECOVER_CHUNKS 32 // Chunks holgados antes de reactivar una etapa
+
+struct DspConfig
+{
+    uint8_t stages;            // Etapas habilitadas (DSP_STAGE_*)
+    int32_t hpfCoeffQ15;       // Polo del HPF en Q15 (32604 ≈ 0.995 → ~13 Hz a 16 kHz)
+    uint8_t hpfFracBits;       // Bits fraccionarios del estado del HPF
+    int32_t gateThreshold;     // Envolvente mínima para abrir la compuerta
+    int32_t gateFloorQ15;      // Ganancia con la compuerta cerrada (Q15)
+    uint32_t gateHoldSamples;  // Tiempo abierta tras caer bajo el umbral
+    uint8_t gateReleaseShift;  // Caída de la envolvente (más alto = más lenta)
+    int32_t gateRampQ15;       // Paso de ganancia por muestra al abrir/cerrar
+    int32_t agcTarget;         // Pico objetivo tras la ganancia
+    int32_t agcMinGainQ8;      // Ganancia mínima (Q8, 256 = x1)
+    int32_t agcMaxGainQ8;      // Ganancia máxima (Q8)
+    uint8_t agcReleaseShift;   // Subida lenta de la ganancia por chunk
+    int32_t limiterCeiling;    // Pico máximo a la salida
+    uint8_t limiterReleaseShift;
+    uint32_t budgetCycles;     // Ciclos permitidos por chunk
+};
+
+// Devuelve un contador de ciclos libre (ESP.getCycleCount() en el ESP32)
+typedef uint32_t (*DspCycleCounter)();
+
+struct DspChain
+{
+    DspConfig cfg;
+    DspCycleCounter cycles;
+    uint8_t active; // Etapas realmente en uso (subconjunto de cfg.stages)
+
+    // HPF (estado con hpfFracBits fraccionarios para no perder precisión)
+    int32_t hpfPrevX;
+    int32_t hpfPrevY;
+
+    // Gate (envolvente con hpfFracBits fraccionarios)
+    int32_t gateEnv;
+    int32_t gateGainQ15;
+    uint32_t gateHold;
+
+    // AGC + limitador
+    int32_t agcGainQ8;
+    int32_t limiterGainQ15;
+
+    // Presupuesto
+    uint32_t stageCycles[DSP_STAGE_COUNT];
+    uint32_t lastCycles;
+    uint32_t slackChunks;
+};
+
+// Valores por defecto. Los niveles están en escala de 16 bits y se desplazan
+// `levelShift` bits para formatos más anchos (8 para 24 bits).
+inline DspConfig dspDefaultConfig(uint32_t budgetCycles, uint32_t sampleRate,
+                                  int32_t hpfCoeffQ15, uint8_t levelShift)
+{
+    DspConfig cfg;
+    cfg.stages = DSP_STAGE_HPF | DSP_STAGE_GATE | DSP_STAGE_AGC;
+    cfg.hpfCoeffQ15 = hpfCoeffQ15;
+    cfg.hpfFracBits = 8 - levelShift / 2; // 24 bits + ganancia x4 deja 4 bits libres
+    cfg.gateThreshold = 400 << levelShift;
+    cfg.gateFloorQ15 = 2068; // -24 dB
+    cfg.gateHoldSamples = sampleRate * 3 / 10; // 300 ms
+    cfg.gateReleaseShift = 10;
+    cfg.gateRampQ15 = 16;
+    cfg.agcTarget = 16000 << levelShift;
+    cfg.agcMinGainQ8 = 64;   // x0.25
+    cfg.agcMaxGainQ8 = 2048; // x8
+    cfg.agcReleaseShift = 3;
+    cfg.limiterCeiling = 30000 << levelShift;
+    cfg.limiterReleaseShift = 9;
+    cfg.budgetCycles = budgetCycles;
+    return cfg;
+}
+
+inline void dspInit(DspChain &dsp, const DspConfig &cfg, DspCycleCounter cycles)
+{
+    memset(&dsp, 0, sizeof(dsp));
+    dsp.cfg = cfg;
+    dsp.cycles = cycles;
+    dsp.active = cfg.stages;
+    dsp.gateGainQ15 = cfg.gateFloorQ15;
+    dsp.agcGainQ8 = 256;
+    dsp.limiterGainQ15 = 32767;
+}
+
+// Reinicia el estado de las etapas (nueva grabación), conserva el presupuesto
+inline void dspReset(DspChain &dsp)
+{
+    dsp.hpfPrevX = 0;
+    dsp.hpfPrevY = 0;
+    dsp.gateEnv = 0;
+    dsp.gateGainQ15 = dsp.cfg.gateFloorQ15;
+    dsp.gateHold = 0;
+    dsp.agcGainQ8 = 256;
+    dsp.limiterGainQ15 = 32767;
+}
+
+// ========== ETAPAS ==========
+// y[n] = x[n] - x[n-1] + a·y[n-1]
+inline void dspHighPass(DspChain &dsp, int32_t *buf, int n)
+{
+    int32_t px = dsp.hpfPrevX;
+    int32_t py = dsp.hpfPrevY;
+    const int64_t a = dsp.cfg.hpfCoeffQ15;
+    const uint8_t frac = dsp.cfg.hpfFracBits;
+
+    for (int i = 0; i < n; i++)
+    {
+        int32_t x = buf[i] << frac;
+        int32_t y = x - px + (int32_t)((a * py) >> 15);
+        px = x;
+        py = y;
+        buf[i] = y >> frac;
+    }
+
+    dsp.hpfPrevX = px;
+    dsp.hpfPrevY = py;
+}
+
+inline void dspNoiseGate(DspChain &dsp, int32_t *buf, int n)
+{
+    const DspConfig &c = dsp.cfg;
+    // La envolvente lleva los mismos bits fraccionarios que el HPF; sin
+    // ellos env >> gateReleaseShift es 0 por debajo de 2^shift y la
+    // envolvente deja de caer antes de llegar al umbral
+    const uint8_t frac = c.hpfFracBits;
+    const int32_t threshold = c.gateThreshold << frac;
+    int32_t env = dsp.gateEnv;
+    int32_t g = dsp.gateGainQ15;
+    uint32_t hold = dsp.gateHold;
+
+    for (int i = 0; i < n; i++)
+    {
+        int32_t mag = (buf[i] < 0 ? -buf[i] : buf[i]) << frac;
+        // Ataque instantáneo, caída exponencial
+        env = mag > env ? mag : env - (env >> c.gateReleaseShift);
+
+        if (env >= threshold)
+            hold = c.gateHoldSamples;
+        else if (hold > 0)
+            hold--;
+
+        int32_t target = hold > 0 ? 32767 : c.gateFloorQ15;
+        if (g < target)
+            g = (std::min)(g + c.gateRampQ15, target);
+        else if (g > target)
+            g = (std::max)(g - c.gateRampQ15, target);
+
+        buf[i] = (int32_t)(((int64_t)buf[i] * g) >> 15);
+    }
+
+    dsp.gateEnv = env;
+    dsp.gateGainQ15 = g;
+    dsp.gateHold = hold;
+}
+
+// La ganancia se calcula con el pico del chunk y se interpola a lo largo del
+// chunk para evitar escalones. Baja de inmediato y sube lentamente.
+inline void dspAgcLimiter(DspChain &dsp, int32_t *buf, int n)
+{
+    const DspConfig &c = dsp.cfg;
+
+    int32_t peak = 0;
+    for (int i = 0; i < n; i++)
+    {
+        int32_t mag = buf[i] < 0 ? -buf[i] : buf[i];
+        if (mag > peak)
+            peak = mag;
+    }
+
+    int32_t from = dsp.agcGainQ8;
+    int32_t to = from;
+
+    // Solo se adapta con voz; el silencio no debe subir la ganancia
+    if (peak >= c.gateThreshold)
+    {
+        int32_t desired = (int32_t)(((int64_t)c.agcTarget << 8) / peak);
+        desired = (std::min)((std::max)(desired, c.agcMinGainQ8), c.agcMaxGainQ8);
+        to = desired < from ? desired : from + ((desired - from) >> c.agcReleaseShift);
+    }
+
+    int32_t lg = dsp.limiterGainQ15;
+    int32_t ceiling = c.limiterCeiling;
+
+    int32_t gQ16 = from << 16;
+    const int32_t stepQ16 = ((to - from) << 16) / n;
+
+    for (int i = 0; i < n; i++)
+    {
+        int32_t s = (int32_t)(((int64_t)buf[i] * (gQ16 >> 16)) >> 8);
+        gQ16 += stepQ16;
+        int32_t v = (int32_t)(((int64_t)s * lg) >> 15);
+        int32_t mag = v < 0 ? -v : v;
+
+        if (mag > ceiling)
+        {
+            // Reducción instantánea justo hasta el techo
+            int32_t smag = s < 0 ? -s : s;
+            lg = (int32_t)(((int64_t)ceiling << 15) / smag);
+            v = v < 0 ? -ceiling : ceiling;
+        }
+        else
+        {
+            lg += (32767 - lg + (1 << c.limiterReleaseShift) - 1) >> c.limiterReleaseShift;
+        }
+        buf[i] = v;
+    }
+
+    dsp.agcGainQ8 = to;
+    dsp.limiterGainQ15 = lg;
+}
+
+// ========== PRESUPUESTO ==========
+inline uint32_t dspEstimatedCycles(const DspChain &dsp, uint8_t stages)
+{
+    uint32_t total = 0;
+    for (int s = 0; s < DSP_STAGE_COUNT; s++)
+    {
+        if (stages & (1 << s))
+            total += dsp.stageCycles[s];
+    }
+    return total;
+}
+
+// Ajusta las etapas activas con el coste medido del último chunk
+inline void dspUpdateBudget(DspChain &dsp)
+{
+    if (dsp.cfg.budgetCycles == 0)
+        return;
+
+    if (dsp.lastCycles > dsp.cfg.budgetCycles)
+    {
+        // Quitar la etapa activa de menor prioridad (bit más alto)
+        for (int s = DSP_STAGE_COUNT - 1; s >= 0; s--)
+        {
+            if (dsp.active & (1 << s))
+            {
+                dsp.active &= ~(1 << s);
+                break;
+            }
+        }
+        dsp.slackChunks = 0;
+        return;
+    }
+
+    uint8_t missing = dsp.cfg.stages & ~dsp.active;
+    if (!missing)
+        return;
+
+    // Reactivar la etapa faltante de mayor prioridad si su último coste
+    // conocido cabe en el 80% del presupuesto
+    for (int s = 0; s < DSP_STAGE_COUNT; s++)
+    {
+        if (missing & (1 << s))
+        {
+            uint8_t candidate = dsp.active | (1 << s);
+            if (dspEstimatedCycles(dsp, candidate) < dsp.cfg.budgetCycles / 5 * 4)
+            {
+                if (++dsp.slackChunks >= DSP_RECOVER_CHUNKS)
+                {
+                    dsp.active = candidate;
+                    dsp.slackChunks = 0;
+                }
+            }
+            else
+            {
+                dsp.slackChunks = 0;
+            }
+            break;
+        }
+    }
+}
+
+// Procesa un chunk in place con las etapas activas y mide su coste
+inline void dspProcessChunk(DspChain &dsp, int32_t *buf, int n)
+{
+    uint32_t start = dsp.cycles();
+    uint32_t t = start;
+
+    if (dsp.active & DSP_STAGE_HPF)
+    {
+        dspHighPass(dsp, buf, n);
+        uint32_t now = dsp.cycles();
+        dsp.stageCycles[0] = now - t;
+        t = now;
+    }
+    if (dsp.active & DSP_STAGE_GATE)
+    {
+        dspNoiseGate(dsp, buf, n);
+        uint32_t now = dsp.cycles();
+        dsp.stageCycles[1] = now - t;
+        t = now;
+    }
+    if (dsp.active & DSP_STAGE_AGC)
+    {
+        dspAgcLimiter(dsp, buf, n);
+        uint32_t now = dsp.cycles();
+        dsp.stageCycles[2] = now - t;
+        t = now;
+    }
+
+    dsp.lastCycles = t - start;
+    dspUpdateBudget(dsp);
+}
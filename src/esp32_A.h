@@ -4,15 +4,24 @@
    Botón:     GPIO 27 → GND
    LED:       GPIO 2
    UART2:     TX=17, RX=16 (comunicación con LilyGo)
+   Enlace:    UART2 por defecto, o ESP-NOW (ver LINK_BACKEND)
 
    Protocolo UART:
-   - Comando START: "START\n"
+   - Comando START: "START <hz>/<bits>\n" (ej. "START 16000/16\n")
    - Comando STOP: "STOP\n"
-   - Datos: chunks de 4096 bytes (2048 samples x 2 bytes)
+   - Datos: chunks de 128 ms (Audio::chunkBytes, 4096 bytes a 16 kHz/16 bits)
+
+   Formato: audio_config.h (AUDIO_SAMPLE_RATE y AUDIO_BITS en platformio.ini)
+
+   DSP: cada chunk pasa por capture_dsp.h (HPF → Gate → AGC/limitador)
+   antes de empaquetarse para el enlace.
 */
 
 #include "driver/i2s.h"
 #include "driver/uart.h"
+#include "audio_config.h"
+#include "capture_dsp.h"
+#include "link_transport.h"
 
 // ========== PINES ==========
 #define MIC_BCK 26
@@ -25,38 +34,49 @@
 #define UART_TX 17
 #define UART_RX 16
 #define UART_NUM UART_NUM_2
-#define UART_BAUD 921600 // Alta velocidad para audio
+
+// Enlace con el ESP32 B: LINK_BACKEND_UART o LINK_BACKEND_ESPNOW
+#define LINK_BACKEND LINK_BACKEND_UART
+#if LINK_BACKEND == LINK_BACKEND_LOOPBACK
+#error "LINK_BACKEND_LOOPBACK no tiene nodo remoto: solo sirve para pruebas de host (test/test_link_loopback)"
+#endif
+#define LINK_ESPNOW_CHANNEL 1 // Debe coincidir con el canal del AP al que se conecta B
+// MAC de B (se imprime al arrancar B). Broadcast funciona pero sin reintentos.
+#define LINK_PEER_MAC {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}
 
 // ========== CONFIGURACIÓN I2S ==========
 #define MIC_PORT I2S_NUM_0
-#define SAMPLE_RATE 16000
-#define SAMPLES_PER_CHUNK 2048
 #define BUFFER_32BIT_SIZE (SAMPLES_PER_CHUNK * 4)
-#define BUFFER_16BIT_SIZE (SAMPLES_PER_CHUNK * 2)
+
+// ========== CONFIGURACIÓN DSP ==========
+#define DSP_STAGES (DSP_STAGE_HPF | DSP_STAGE_GATE | DSP_STAGE_AGC)
+#define DSP_BUDGET_PCT 25 // % del tiempo real del chunk (128 ms) para el DSP
 
 // ========== VARIABLES GLOBALES ==========
 bool isRecording = false;
 int chunkCounter = 0;
+DspChain dsp;
+LinkTransport *nodeLink = NULL;
 
-void setupUART()
+void setupLink()
 {
-    Serial.println("📡 Configurando UART2...");
-
-    uart_config_t uart_config = {
-        .baud_rate = UART_BAUD,
-        .data_bits = UART_DATA_8_BITS,
-        .parity = UART_PARITY_DISABLE,
-        .stop_bits = UART_STOP_BITS_1,
-        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
-        .rx_flow_ctrl_thresh = 122,
-        .source_clk = UART_SCLK_APB,
-    };
-
-    uart_driver_install(UART_NUM, 8192, 8192, 0, NULL, 0);
-    uart_param_config(UART_NUM, &uart_config);
-    uart_set_pin(UART_NUM, UART_TX, UART_RX, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
-
-    Serial.println("✅ UART2 listo");
+#if LINK_BACKEND == LINK_BACKEND_ESPNOW
+    static const uint8_t peerMac[6] = LINK_PEER_MAC;
+    nodeLink = new EspNowTransport(peerMac, LINK_ESPNOW_CHANNEL, 8192);
+#else
+    nodeLink = new UartTransport(UART_NUM, UART_TX, UART_RX, LINK_BAUD, 8192, LINK_TX_BUFFER);
+#endif
+
+    Serial.printf("📡 Configurando enlace %s...\n", nodeLink->name());
+
+    if (nodeLink->begin())
+    {
+        Serial.printf("✅ Enlace %s listo\n", nodeLink->name());
+    }
+    else
+    {
+        Serial.printf("❌ Error iniciando enlace %s\n", nodeLink->name());
+    }
 }
 
 void setupMicrophone()
@@ -103,9 +123,28 @@ void setupMicrophone()
     }
 }
 
-void sendUARTCommand(const char *cmd)
+uint32_t readCycleCount()
+{
+    return ESP.getCycleCount();
+}
+
+void setupDSP()
+{
+    // Ciclos disponibles en el tiempo real de un chunk
+    uint64_t chunkCycles = (uint64_t)getCpuFrequencyMhz() * 1000000ULL * SAMPLES_PER_CHUNK / SAMPLE_RATE;
+    uint32_t budget = (uint32_t)(chunkCycles * DSP_BUDGET_PCT / 100);
+
+    DspConfig cfg = dspDefaultConfig(budget, Audio::sampleRate, Audio::hpfCoeffQ15, Audio::levelShift);
+    cfg.stages = DSP_STAGES;
+    dspInit(dsp, cfg, readCycleCount);
+
+    Serial.printf("✅ DSP listo (etapas 0x%02x, presupuesto %u ciclos/chunk)\n", cfg.stages, budget);
+}
+
+void sendLinkCommand(const char *cmd)
 {
-    uart_write_bytes(UART_NUM, cmd, strlen(cmd));
+    nodeLink->send((const uint8_t *)cmd, strlen(cmd));
+    nodeLink->flush();
     Serial.printf("📤 Comando enviado: %s", cmd);
 }
 
@@ -113,10 +152,14 @@ void startRecording()
 {
     isRecording = true;
     chunkCounter = 0;
+    dspReset(dsp);
+    nodeLink->resetStats();
     digitalWrite(LED_PIN, HIGH);
 
     Serial.println("\n🔴 INICIANDO GRABACIÓN...");
-    sendUARTCommand("START\n");
+    char cmd[32];
+    snprintf(cmd, sizeof(cmd), LINK_CMD_START " %u/%u\n", (unsigned)Audio::sampleRate, (unsigned)Audio::bitsPerSample);
+    sendLinkCommand(cmd);
     delay(50); // Dar tiempo al receptor para prepararse
 }
 
@@ -126,7 +169,7 @@ void captureAndSendAudio()
         return;
 
     static int32_t buffer32[SAMPLES_PER_CHUNK];
-    static int16_t buffer16[SAMPLES_PER_CHUNK];
+    static uint8_t wire[Audio::chunkBytes];
     size_t bytesRead = 0;
 
     // Leer audio del micrófono
@@ -136,21 +179,24 @@ void captureAndSendAudio()
     {
         int samples = bytesRead / 4;
 
-        // Convertir de 32-bit a 16-bit con ganancia
+        // Escalar al formato del enlace (ganancia x4) y aplicar la cadena DSP in place
         for (int i = 0; i < samples; i++)
         {
-            int32_t s32 = buffer32[i] >> 14; // Shift + ganancia x4
-
-            if (s32 > 32767)
-                s32 = 32767;
-            if (s32 < -32768)
-                s32 = -32768;
+            buffer32[i] >>= Audio::micShift;
+        }
 
-            buffer16[i] = (int16_t)s32;
+        uint8_t activeBefore = dsp.active;
+        dspProcessChunk(dsp, buffer32, samples);
+        if (dsp.active != activeBefore)
+        {
+            Serial.printf("⚠  DSP: %u ciclos (presupuesto %u), etapas 0x%02x → 0x%02x\n",
+                          dsp.lastCycles, dsp.cfg.budgetCycles, activeBefore, dsp.active);
         }
 
-        // Enviar por UART
-        int bytesSent = uart_write_bytes(UART_NUM, (const char *)buffer16, samples * 2);
+        // Empaquetar a 16 o 24 bits y enviar al ESP32 B
+        Audio::pack(buffer32, wire, samples);
+        int bytesSent = nodeLink->send(wire, samples * Audio::bytesPerSample);
+        nodeLink->flush();
 
         if (bytesSent > 0)
         {
@@ -159,13 +205,14 @@ void captureAndSendAudio()
             // Debug cada 10 chunks
             if (chunkCounter % 10 == 0)
             {
-                Serial.printf("🎤 Chunk %d enviado (%d bytes) - Sample[0]: %d\n",
-                              chunkCounter, bytesSent, buffer16[0]);
+                Serial.printf("🎤 Chunk %d enviado (%d bytes) - Sample[0]: %d - DSP: %u ciclos (%u%%)\n",
+                              chunkCounter, bytesSent, (int)buffer32[0], dsp.lastCycles,
+                              (unsigned)((uint64_t)dsp.lastCycles * 100 / max(dsp.cfg.budgetCycles, 1u)));
             }
         }
         else
         {
-            Serial.println("⚠  Error enviando datos por UART");
+            Serial.printf("⚠  Error enviando datos por %s\n", nodeLink->name());
         }
     }
 }
@@ -179,7 +226,8 @@ void stopRecording()
     digitalWrite(LED_PIN, LOW);
 
     Serial.printf("\n✅ Grabación completa - %d chunks enviados\n", chunkCounter);
-    sendUARTCommand("STOP\n");
+    sendLinkCommand(LINK_CMD_STOP);
+    nodeLink->printStats();
 
     delay(100); // Asegurar que se envíe todo
 }
@@ -197,12 +245,17 @@ void setup()
     Serial.println("║   INMP441 → UART → LilyGo             ║");
     Serial.println("╚═══════════════════════════════════════╝\n");
 
-    setupUART();
+    setupLink();
     delay(100);
 
     setupMicrophone();
     delay(100);
 
+    setupDSP();
+
+    Serial.printf("🎚  Formato: %u Hz, %u bits, %u bytes/chunk\n",
+                  (unsigned)Audio::sampleRate, (unsigned)Audio::bitsPerSample, (unsigned)Audio::chunkBytes);
+
     Serial.println("\n✅ Sistema listo");
     Serial.println("🎤 Presiona el botón para grabar\n");
 }
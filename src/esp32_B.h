@@ -2,7 +2,9 @@
    Hardware:
    MAX98357A: BCLK=22, LRC=4, DIN=21
    MicroSD:   MISO=2, MOSI=15, SCK=14, CS=13
-   UART2:     TX=26, RX=27 (recibe de NodeMCU)
+   UART2:     TX=26, RX=27 (recibe del NodeMCU 1)
+   UART1:     RX=33, sin TX (NodeMCU 2, solo con CAPTURE_NODES=2)
+   Enlace:    UART2 por defecto, o ESP-NOW (ver LINK_BACKEND)
    LED:       GPIO 12
 
    Flujo:
@@ -11,6 +13,24 @@
    3. SD → Guarda audio
    4. HTTP → Envía al servidor
    5. I2S → Reproduce respuesta
+
+   Cola de turnos:
+   Cada grabación (START..STOP) es un turno con su propio ID. La captura
+   por UART corre en loop(), la subida en tareas de fondo y la reproducción
+   en otra tarea, así que se puede grabar una nueva pregunta mientras la
+   anterior se sube, se procesa en el backend o se reproduce. Las respuestas
+   se reproducen siempre en el orden de los turnos de cada nodo.
+
+   Varios nodos: con -D CAPTURE_NODES=N, B atiende a N nodos A a la vez,
+   cada uno por su UART (NODE_UART_PINS). Subidas y bocina se reparten
+   entre nodos por turnos, y un turno lento de un nodo no retrasa las
+   respuestas de los demás.
+
+   Earcons: al soltar el botón suena /earcons/ack.wav (LittleFS) y, si la
+   respuesta tarda, los thinking*.wav hasta que llega y se funde con ella.
+
+   Traza: compilando con -D TRACE_ENABLED=1 se guarda /trace.bin en la SD
+   (ver trace.h y tools/trace_replay.py).
 */
 
 #include "driver/i2s.h"
@@ -23,7 +43,12 @@
 #include <BLE2902.h>
 #include "SD.h"
 #include "SPI.h"
+#include <LittleFS.h>
 #include <ArduinoJson.h>
+#include "audio_config.h"
+#include "audio_codec.h"
+#include "link_transport.h"
+#include "trace.h"
 
 // ========== CONFIGURACIÓN ==========
 const int serverPort = 8000;
@@ -53,47 +78,236 @@ bool sdCardReady = false;
 #define SD_SCK 14
 #define SD_CS 13
 
-// 📡 UART para recibir de NodeMCU
-#define UART_TX 26 // TX del LilyGo (no usado)
-#define UART_RX 27 // RX del LilyGo → conectar a TX del NodeMCU
-#define UART_NUM UART_NUM_2
-#define UART_BAUD 921600
+// 📡 UART para recibir de NodeMCU (un UART por nodo de captura)
+// Solo se configuran los CAPTURE_NODES primeros. Los nodos sin retorno no
+// reservan TX (UART_PIN_NO_CHANGE) y su RX usa un pin con pull-up interno,
+// para que el reposo de la línea sea estable aunque A esté desconectado.
+struct NodeUartPins
+{
+    uart_port_t port;
+    int tx;
+    int rx;
+};
+
+const NodeUartPins NODE_UART_PINS[] = {
+    {UART_NUM_2, 26, 27},                 // Nodo 1: RX ← TX del NodeMCU, TX → retorno opcional
+    {UART_NUM_1, UART_PIN_NO_CHANGE, 33}, // Nodo 2: RX ← TX del NodeMCU, sin retorno
+};
+
+// Enlace con el ESP32 A: LINK_BACKEND_UART o LINK_BACKEND_ESPNOW
+// Con ESP-NOW, A debe usar el canal del AP al que se conecta B.
+#define LINK_BACKEND LINK_BACKEND_UART
+#if LINK_BACKEND == LINK_BACKEND_LOOPBACK
+#error "LINK_BACKEND_LOOPBACK no tiene nodo remoto: solo sirve para pruebas de host (test/test_link_loopback)"
+#endif
+#define LINK_PEER_MAC {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF} // Acepta cualquier A
 
 // 💡 LED
 #define LED_PIN 12
 
 #define SPK_PORT I2S_NUM_0
-#define SAMPLE_RATE 16000
 
 // ========== VARIABLES DE AUDIO ==========
-bool isReceiving = false;
-bool isPlaying = false;
-File audioFile;
-const char *recordingPath = "/recording.pcm";
-const char *responsePath = "/response.wav";
+volatile bool isPlaying = false;
+
+// ========== NODOS DE CAPTURA ==========
+// Con UART, B atiende un ESP32 A por cada UART libre. Cada nodo tiene su
+// propio estado de recepción, grabación y orden de turnos; la subida y la
+// bocina se reparten entre nodos por turnos (round-robin). Por defecto se
+// atiende un nodo; con UART se pueden más con -D CAPTURE_NODES=N en
+// platformio.ini (hasta las entradas de NODE_UART_PINS). ESP-NOW atiende
+// un solo nodo.
+#ifndef CAPTURE_NODES
+#define CAPTURE_NODES 1
+#endif
+#if LINK_BACKEND != LINK_BACKEND_UART && CAPTURE_NODES != 1
+#error "Solo el enlace UART admite CAPTURE_NODES > 1"
+#endif
+static_assert(CAPTURE_NODES >= 1 && CAPTURE_NODES <= sizeof(NODE_UART_PINS) / sizeof(NODE_UART_PINS[0]),
+              "CAPTURE_NODES necesita una entrada de pines por nodo en NODE_UART_PINS");
+#define LINK_READ_BYTES 256   // Bytes por lectura del enlace
+#define LINK_READS_PER_POLL 8 // Lecturas máximas por nodo en cada pasada de loop()
+#define RECORD_IDLE_TIMEOUT_MS 3000 // Grabación sin datos: el nodo se cayó a mitad
+
+struct CaptureNode
+{
+    LinkTransport *link;
+    File file;             // Grabación en curso
+    volatile int recordingSlot; // Turno que se está grabando (-1 = ninguno)
+    uint32_t recordStartMs;
+    uint32_t lastRxMs;     // Últimos datos recibidos durante la grabación
+    uint32_t recordBytes;
+    uint8_t cmdTail[LINK_CMD_MAX_LEN - 1]; // Final de la última lectura (¿comando partido?)
+    size_t cmdTailLen;
+    uint32_t nextQueueSeq; // Orden de reproducción de los turnos del nodo
+    uint32_t nextPlaySeq;
+
+    // Telemetría acumulada
+    uint32_t turnsDone;
+    uint32_t bytesTotal;
+    uint32_t recordMsTotal;
+    uint32_t queueMsTotal;   // STOP → empieza la subida
+    uint32_t queueMsMax;
+    uint32_t speakerMsTotal; // Respuesta lista → empieza a sonar
+    uint32_t speakerMsMax;
+};
+
+CaptureNode nodes[CAPTURE_NODES];
+
+// Mientras un nodo graba no debe sonar nada suyo (ack, prompts) para que no
+// se cuele en su micrófono. Los demás nodos siguen con normalidad.
+bool nodeRecording(int n)
+{
+    return nodes[n].recordingSlot >= 0;
+}
+
+bool anyNodeRecording()
+{
+    for (int n = 0; n < CAPTURE_NODES; n++)
+    {
+        if (nodeRecording(n))
+            return true;
+    }
+    return false;
+}
+
+// ========== TAMAÑO DE CHUNK ADAPTATIVO ==========
+// El tamaño de chunk y el timeout se ajustan con el RTT y el goodput medidos
+// en cada chunk, como un control de congestión sencillo: crecen mientras los
+// chunks tardan menos de UPLOAD_TARGET_RTT_MS y se reducen a la mitad tras un
+// timeout o error de conexión.
+#define UPLOAD_CHUNK_MIN 1024
+#define UPLOAD_CHUNK_INIT 4096
+#define UPLOAD_CHUNK_MAX 16384
+#define UPLOAD_CHUNK_STEP 1024       // Crecimiento tras cada chunk rápido
+#define UPLOAD_TARGET_RTT_MS 800     // Por encima se reduce el chunk
+#define UPLOAD_TIMEOUT_INIT_MS 5000
+#define UPLOAD_TIMEOUT_MIN_MS 1500
+#define UPLOAD_TIMEOUT_MAX_MS 15000
+#define UPLOAD_TIMEOUT_GOODPUT_FACTOR 2 // Timeout >= 2 × chunk / goodput
+#define UPLOAD_LAST_TIMEOUT_MS 60000 // Último chunk: incluye el procesamiento del backend
+
+struct UploadEstimate
+{
+    uint32_t chunkSize;  // Bytes por chunk
+    uint32_t srttMs;     // RTT suavizado por chunk (0 = sin medidas)
+    uint32_t rttVarMs;   // Variación del RTT
+    uint32_t goodputBps; // Bytes confirmados por segundo
+    uint32_t timeoutMs;  // Timeout de los chunks intermedios
+};
+
+// Compartida por los workers de subida: todos usan el mismo enlace
+UploadEstimate uploadEstimate = {UPLOAD_CHUNK_INIT, 0, 0, 0, UPLOAD_TIMEOUT_INIT_MS};
+portMUX_TYPE uploadEstimateMux = portMUX_INITIALIZER_UNLOCKED;
+
+// ========== COLA DE TURNOS ==========
+#define MAX_TURNS_PER_NODE 4 // Turnos en vuelo por nodo (grabando + en cola + reproduciendo)
+#define MAX_TURNS (MAX_TURNS_PER_NODE * CAPTURE_NODES)
+#define UPLOAD_WORKERS 2     // Subidas simultáneas al backend
+
+enum TurnState
+{
+    TURN_FREE,
+    TURN_RECORDING,
+    TURN_QUEUED,
+    TURN_UPLOADING,
+    TURN_READY,
+    TURN_FAILED
+};
+
+struct Turn
+{
+    uint32_t id;  // ID del turno para el backend (X-Turn-Id)
+    uint32_t session; // Arranque en que se grabó (X-Session-Id)
+    uint32_t seq; // Orden de reproducción dentro de su nodo
+    uint8_t node; // Nodo de captura que lo grabó
+    volatile TurnState state;
+    char recordingPath[24];
+    char responsePath[24];
+    uint32_t stopMs;     // Fin de la grabación
+    uint32_t uploadMs;   // Inicio de la subida
+    uint32_t responseMs; // Respuesta guardada en SD
+    uint32_t ackedOffset; // Bytes confirmados por el servidor
+    uint32_t ackedChunks; // Chunks confirmados por el servidor
+    uint32_t spoolDrains; // Veces que se ha reanudado desde el spool
+    UploadEstimate upload; // Estimación del enlace al terminar la subida
+};
+
+Turn turns[MAX_TURNS];
+portMUX_TYPE turnsMux = portMUX_INITIALIZER_UNLOCKED;
+SemaphoreHandle_t uploadSignal = NULL; // Cuenta los turnos en cola de subida
+uint32_t nextTurnId = 1; // Se reinicia en cada arranque: va con sessionId
+uint32_t sessionId = 0;  // Nonce aleatorio por arranque
+int nextUploadNode = 0;
+int nextPlayNode = 0;
+
+// ========== REINTENTOS Y SPOOL ==========
+#define MAX_CHUNK_RETRIES 5 // Reintentos por chunk antes de pasar al spool
+#define RETRY_BASE_MS 250   // Espera inicial, se duplica en cada intento
+#define RETRY_MAX_MS 8000   // Tope de la espera entre intentos
+#define SPOOL_DIR "/spool"
+#define SPOOL_BATCH 2        // Turnos del spool que se re-encolan a la vez
+#define SPOOL_CHECK_MS 5000  // Cada cuánto se revisa el spool con WiFi activo
+#define SPOOL_MAX_DRAINS 5   // Reanudaciones antes de apartar el turno
+#define SPOOL_BAD_DIR "/spool_bad" // Turnos apartados, no se vuelven a subir
+
+// Progreso guardado junto a cada grabación del spool (/spool/t<id>.ack)
+struct SpoolMeta
+{
+    uint32_t turnId;
+    uint32_t ackedOffset;
+    uint32_t ackedChunks;
+    uint32_t node;   // Añadido después: los .ack antiguos no lo tienen (nodo 0)
+    uint32_t drains; // Añadido después: reanudaciones ya hechas (0 si no está)
+    uint32_t session; // Añadido después: arranque del turno (0 si no está)
+};
+
+enum UploadResult
+{
+    UPLOAD_OK,         // Respuesta guardada en SD
+    UPLOAD_INCOMPLETE, // Faltan datos por confirmar → spool
+    UPLOAD_ERROR       // Error local o rechazo definitivo (4xx), no se reintenta
+};
 
 // ========== BLE ==========
 BLEServer *pServer = NULL;
 BLECharacteristic *pCharacteristic = NULL;
 bool deviceConnected = false;
 
-struct WAVHeader
+// Campos del chunk "fmt " que necesita la reproducción
+struct WavInfo
 {
-    char riff[4];
-    uint32_t fileSize;
-    char wave[4];
-    char fmt[4];
-    uint32_t fmtSize;
     uint16_t audioFormat;
     uint16_t numChannels;
     uint32_t sampleRate;
-    uint32_t byteRate;
     uint16_t blockAlign;
     uint16_t bitsPerSample;
-    char data[4];
     uint32_t dataSize;
 };
 
+#define SPK_FRAMES 512           // Frames estéreo por escritura I2S
+#define MAX_ADPCM_BLOCK 2048     // blockAlign máximo aceptado para IMA ADPCM
+#define PCM_BUFFER_SAMPLES 4096  // Muestras PCM16 decodificadas por lectura
+
+uint32_t speakerRate = SAMPLE_RATE;
+
+// ========== EARCONS ==========
+#define EARCON_DIR "/earcons"
+#define EARCON_ACK EARCON_DIR "/ack.wav"
+#define MAX_THINKING_PROMPTS 4
+#define PROMPT_DELAY_MS 1200 // Espera tras STOP antes del primer prompt
+#define PROMPT_GAP_MS 2500   // Silencio entre prompts de espera
+#define CROSSFADE_MS 250     // Fundido del prompt a la respuesta
+
+bool earconsReady = false;
+volatile int ackNode = -1; // Nodo que espera el ack de su STOP (-1 = ninguno)
+bool promptActive = false;
+int promptNode = 0;        // Nodo al que va dirigido el prompt en curso
+char thinkingPaths[MAX_THINKING_PROMPTS][32];
+int thinkingCount = 0;
+int nextThinking = 0;
+uint32_t lastPromptEndMs = 0;
+
 // ========== CALLBACKS BLE ==========
 class MyServerCallbacks : public BLEServerCallbacks
 {
@@ -211,26 +425,42 @@ void shutdownBLE()
     Serial.println("✅ Bluetooth cerrado\n");
 }
 
-// ========== SETUP UART ==========
-void setupUART()
+// ========== SETUP ENLACE ==========
+void setupLink()
 {
-    Serial.println("📡 Configurando UART2...");
+#if LINK_BACKEND == LINK_BACKEND_ESPNOW
+    static const uint8_t peerMac[6] = LINK_PEER_MAC;
+    nodes[0].link = new EspNowTransport(peerMac, WiFi.channel(), LINK_RX_BUFFER);
+#else
+    for (int n = 0; n < CAPTURE_NODES; n++)
+    {
+        const NodeUartPins &pins = NODE_UART_PINS[n];
+        nodes[n].link = new UartTransport(pins.port, pins.tx, pins.rx, LINK_BAUD, LINK_RX_BUFFER, 0);
+    }
+#endif
 
-    uart_config_t uart_config = {
-        .baud_rate = UART_BAUD,
-        .data_bits = UART_DATA_8_BITS,
-        .parity = UART_PARITY_DISABLE,
-        .stop_bits = UART_STOP_BITS_1,
-        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
-        .rx_flow_ctrl_thresh = 122,
-        .source_clk = UART_SCLK_APB,
-    };
+    for (int n = 0; n < CAPTURE_NODES; n++)
+    {
+        CaptureNode &node = nodes[n];
+        node.recordingSlot = -1;
+        node.nextQueueSeq = 1;
+        node.nextPlaySeq = 1;
 
-    uart_driver_install(UART_NUM, 16384, 0, 0, NULL, 0);
-    uart_param_config(UART_NUM, &uart_config);
-    uart_set_pin(UART_NUM, UART_TX, UART_RX, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+        Serial.printf("📡 Configurando enlace %s del nodo %d...\n", node.link->name(), n + 1);
 
-    Serial.println("✅ UART2 listo");
+        if (node.link->begin())
+        {
+            Serial.printf("✅ Enlace %s del nodo %d listo\n", node.link->name(), n + 1);
+        }
+        else
+        {
+            Serial.printf("❌ Error iniciando enlace %s del nodo %d\n", node.link->name(), n + 1);
+        }
+    }
+
+#if LINK_BACKEND == LINK_BACKEND_ESPNOW
+    Serial.printf("📍 MAC para el ESP32 A: %s (canal %d)\n", WiFi.macAddress().c_str(), WiFi.channel());
+#endif
 }
 
 // ========== SETUP SD ==========
@@ -297,7 +527,7 @@ void setupSpeaker()
     i2s_config_t spkConfig = {
         .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX),
         .sample_rate = SAMPLE_RATE,
-        .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
+        .bits_per_sample = Audio::speakerBits,
         .channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT,
         .communication_format = (i2s_comm_format_t)(I2S_COMM_FORMAT_STAND_I2S),
         .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
@@ -335,13 +565,18 @@ void initializeHardware()
     setupSDCard();
     delay(100);
 
+    if (sdCardReady)
+    {
+        traceBegin(Audio::sampleRate, Audio::bitsPerSample);
+    }
+
     setupWiFi();
     delay(100);
 
     setupSpeaker();
     delay(200);
 
-    setupUART();
+    setupLink();
     delay(100);
 
     Serial.println("\n✅ ¡SISTEMA LISTO!\n");
@@ -349,7 +584,278 @@ void initializeHardware()
 }
 
 // ========== REPRODUCIR AUDIO ==========
-void playAudioFromSD()
+// Recorre los chunks RIFF hasta "data". Deja el archivo al inicio del audio.
+bool readWavHeader(File &file, WavInfo &wav)
+{
+    uint8_t riff[12];
+    if (file.read(riff, 12) != 12 || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0)
+        return false;
+
+    bool haveFmt = false;
+    uint8_t chunk[8];
+    while (file.read(chunk, 8) == 8)
+    {
+        uint32_t size = chunk[4] | (chunk[5] << 8) | (chunk[6] << 16) | ((uint32_t)chunk[7] << 24);
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16)
+        {
+            uint8_t fmt[16];
+            if (file.read(fmt, 16) != 16)
+                return false;
+            wav.audioFormat = fmt[0] | (fmt[1] << 8);
+            wav.numChannels = fmt[2] | (fmt[3] << 8);
+            wav.sampleRate = fmt[4] | (fmt[5] << 8) | (fmt[6] << 16) | ((uint32_t)fmt[7] << 24);
+            wav.blockAlign = fmt[12] | (fmt[13] << 8);
+            wav.bitsPerSample = fmt[14] | (fmt[15] << 8);
+            file.seek(file.position() + size - 16 + (size & 1));
+            haveFmt = true;
+        }
+        else if (memcmp(chunk, "data", 4) == 0)
+        {
+            wav.dataSize = size;
+            return haveFmt;
+        }
+        else
+        {
+            file.seek(file.position() + size + (size & 1));
+        }
+    }
+    return false;
+}
+
+// Lee un WAV por bloques (PCM 16 bits, µ-law o IMA ADPCM, mono o estéreo)
+// y entrega PCM16 estéreo. Sirve tanto para respuestas de la SD como para
+// los earcons de la flash.
+struct WavReader
+{
+    File file;
+    WavInfo wav;
+    uint32_t remaining = 0;
+    uint8_t *in = NULL;
+    int16_t *pcm = NULL;
+    int pcmFrames = 0;
+    int pcmPos = 0;
+
+    bool open(fs::FS &fs, const char *path)
+    {
+        file = fs.open(path, FILE_READ);
+        if (!file)
+            return false;
+
+        if (!readWavHeader(file, wav) || !supported())
+        {
+            file.close();
+            return false;
+        }
+
+        in = (uint8_t *)malloc(MAX_ADPCM_BLOCK);
+        pcm = (int16_t *)malloc(PCM_BUFFER_SAMPLES * sizeof(int16_t));
+        if (!in || !pcm)
+        {
+            close();
+            return false;
+        }
+
+        remaining = wav.dataSize;
+        pcmFrames = pcmPos = 0;
+        return true;
+    }
+
+    bool supported() const
+    {
+        return (wav.numChannels == 1 || wav.numChannels == 2) &&
+               ((wav.audioFormat == WAVE_FORMAT_PCM && wav.bitsPerSample == 16) ||
+                wav.audioFormat == WAVE_FORMAT_MULAW ||
+                (wav.audioFormat == WAVE_FORMAT_IMA_ADPCM && wav.blockAlign <= MAX_ADPCM_BLOCK &&
+                 wav.blockAlign > 4 * wav.numChannels));
+    }
+
+    // Decodifica el siguiente bloque del archivo en `pcm`
+    bool fill()
+    {
+        if (remaining == 0 || !file.available())
+            return false;
+
+        int samples = 0;
+        if (wav.audioFormat == WAVE_FORMAT_IMA_ADPCM)
+        {
+            int read = file.read(in, min(remaining, (uint32_t)wav.blockAlign));
+            if (read <= 0)
+                return false;
+            remaining -= read;
+            samples = decodeImaAdpcmBlock(in, read, wav.numChannels, pcm) * wav.numChannels;
+        }
+        else if (wav.audioFormat == WAVE_FORMAT_MULAW)
+        {
+            int read = file.read(in, min(remaining, (uint32_t)MAX_ADPCM_BLOCK));
+            if (read <= 0)
+                return false;
+            remaining -= read;
+            decodeMulaw(in, read, pcm);
+            samples = read;
+        }
+        else
+        {
+            int read = file.read((uint8_t *)pcm, min(remaining, (uint32_t)(PCM_BUFFER_SAMPLES * 2)));
+            if (read <= 0)
+                return false;
+            remaining -= read;
+            samples = read / 2;
+        }
+
+        pcmFrames = samples / wav.numChannels;
+        pcmPos = 0;
+        return pcmFrames > 0;
+    }
+
+    // Escribe hasta `frames` frames estéreo. Devuelve 0 al terminar.
+    int read(int16_t *stereo, int frames)
+    {
+        int written = 0;
+        while (written < frames)
+        {
+            if (pcmPos >= pcmFrames && !fill())
+                break;
+
+            int n = min(frames - written, pcmFrames - pcmPos);
+            const int16_t *src = pcm + pcmPos * wav.numChannels;
+            int16_t *dst = stereo + written * 2;
+
+            for (int i = 0; i < n; i++)
+            {
+                dst[i * 2] = src[wav.numChannels == 1 ? i : i * 2];
+                dst[i * 2 + 1] = src[wav.numChannels == 1 ? i : i * 2 + 1];
+            }
+            pcmPos += n;
+            written += n;
+        }
+        return written;
+    }
+
+    void close()
+    {
+        if (file)
+            file.close();
+        free(in);
+        free(pcm);
+        in = NULL;
+        pcm = NULL;
+    }
+};
+
+WavReader prompt; // Earcon o prompt de espera en curso
+
+// Amplifica y envía PCM16 (mono o estéreo) a la bocina, convirtiendo mono
+// a estéreo por bloques de SPK_FRAMES y al ancho de slot de AUDIO_BITS.
+void writeSamplesToSpeaker(const int16_t *pcm, int samples, int channels)
+{
+    static Audio::Slot stereo[SPK_FRAMES * 2];
+    int frames = samples / channels;
+    size_t written;
+
+    for (int offset = 0; offset < frames; offset += SPK_FRAMES)
+    {
+        int n = min(frames - offset, SPK_FRAMES);
+        const int16_t *src = pcm + offset * channels;
+
+        for (int i = 0; i < n * 2; i++)
+        {
+            int32_t amp = src[channels == 1 ? i / 2 : i] * 3;
+            if (amp > 32767)
+                amp = 32767;
+            if (amp < -32768)
+                amp = -32768;
+            stereo[i] = Audio::toSlot((int16_t)amp);
+        }
+        i2s_write(SPK_PORT, stereo, n * 2 * sizeof(Audio::Slot), &written, portMAX_DELAY);
+    }
+}
+
+// La respuesta o un earcon pueden venir a otra frecuencia que la captura
+void setSpeakerRate(uint32_t rate)
+{
+    if (rate != speakerRate && rate > 0)
+    {
+        i2s_set_sample_rates(SPK_PORT, rate);
+        speakerRate = rate;
+    }
+}
+
+// ========== ENMASCARAR LATENCIA ==========
+// Earcons y prompts de "pensando" en LittleFS (/earcons). Tras STOP suena
+// ack.wav; si la respuesta tarda, se repiten los thinking*.wav. Cuando llega
+// la respuesta, el prompt en curso se funde con ella en CROSSFADE_MS.
+bool setupEarcons()
+{
+    if (!LittleFS.begin(false))
+    {
+        Serial.println("⚠  LittleFS no disponible, sin earcons");
+        return false;
+    }
+
+    thinkingCount = 0;
+    File dir = LittleFS.open(EARCON_DIR);
+    if (dir && dir.isDirectory())
+    {
+        File entry = dir.openNextFile();
+        while (entry && thinkingCount < MAX_THINKING_PROMPTS)
+        {
+            const char *name = strrchr(entry.name(), '/');
+            name = name ? name + 1 : entry.name();
+            if (strncmp(name, "thinking", 8) == 0)
+            {
+                snprintf(thinkingPaths[thinkingCount++], sizeof(thinkingPaths[0]), EARCON_DIR "/%s", name);
+            }
+            entry.close();
+            entry = dir.openNextFile();
+        }
+        dir.close();
+    }
+
+    earconsReady = LittleFS.exists(EARCON_ACK) || thinkingCount > 0;
+    Serial.printf("%s Earcons: ack %s, %d prompt(s) de espera\n", earconsReady ? "✅" : "⚠ ",
+                  LittleFS.exists(EARCON_ACK) ? "sí" : "no", thinkingCount);
+    return earconsReady;
+}
+
+void stopPrompt()
+{
+    prompt.close();
+    promptActive = false;
+    lastPromptEndMs = millis();
+}
+
+bool startPrompt(const char *path, int node)
+{
+    if (!prompt.open(LittleFS, path))
+        return false;
+
+    if (!isPlaying)
+    {
+        setSpeakerRate(prompt.wav.sampleRate);
+    }
+    promptActive = true;
+    promptNode = node;
+    return true;
+}
+
+// Reproduce un bloque del prompt en curso. Se corta si su nodo empieza a
+// grabar para que el prompt no se cuele en el micrófono.
+void pumpPrompt()
+{
+    static int16_t block[SPK_FRAMES * 2];
+    int n = nodeRecording(promptNode) ? 0 : prompt.read(block, SPK_FRAMES);
+    if (n == 0)
+    {
+        stopPrompt();
+        return;
+    }
+    writeSamplesToSpeaker(block, n * 2, 2);
+}
+
+// Reproduce la respuesta decodificando por bloques mientras se lee de la SD.
+// Si hay un prompt sonando, se funde con él en vez de cortarlo.
+void playAudioFromSD(const char *responsePath)
 {
     if (isPlaying)
         return;
@@ -357,88 +863,60 @@ void playAudioFromSD()
 
     Serial.println("🔊 Reproduciendo...");
 
-    File file = SD.open(responsePath, FILE_READ);
-    if (!file)
+    WavReader response;
+    if (!response.open(SD, responsePath))
     {
-        Serial.println("❌ Error abriendo respuesta");
+        Serial.println("❌ Error abriendo respuesta o formato no soportado");
         isPlaying = false;
         return;
     }
 
-    WAVHeader hdr;
-    if (file.read((uint8_t *)&hdr, sizeof(WAVHeader)) != sizeof(WAVHeader))
+    WavInfo &wav = response.wav;
+    Serial.printf("📊 %dHz, %dch, %dbits, formato 0x%04x\n",
+                  wav.sampleRate, wav.numChannels, wav.bitsPerSample, wav.audioFormat);
+
+    // Solo se puede mezclar a la misma frecuencia
+    if (promptActive && prompt.wav.sampleRate != wav.sampleRate)
     {
-        Serial.println("❌ Error leyendo WAV header");
-        file.close();
-        isPlaying = false;
-        return;
+        stopPrompt();
     }
 
-    Serial.printf("📊 %dHz, %dch, %dbits\n", hdr.sampleRate, hdr.numChannels, hdr.bitsPerSample);
-
-    i2s_zero_dma_buffer(SPK_PORT);
-    delay(100);
-
-    uint8_t *buf = (uint8_t *)malloc(4096);
-    if (!buf)
+    if (!promptActive)
     {
-        file.close();
-        isPlaying = false;
-        return;
+        setSpeakerRate(wav.sampleRate);
+        i2s_zero_dma_buffer(SPK_PORT);
+        delay(100);
     }
 
-    size_t written;
-    while (file.available())
+    static int16_t mix[SPK_FRAMES * 2];
+    static int16_t fill[SPK_FRAMES * 2];
+    int fadeFrames = max((int)(wav.sampleRate * CROSSFADE_MS / 1000), 1);
+    int faded = 0;
+    int n;
+
+    while ((n = response.read(mix, SPK_FRAMES)) > 0)
     {
-        int read = file.read(buf, 4096);
-        if (read > 0)
+        if (promptActive)
         {
-            if (hdr.numChannels == 1)
+            int m = prompt.read(fill, n);
+            for (int i = 0; i < n; i++)
             {
-                // Convertir mono a estéreo con amplificación
-                int16_t *mono = (int16_t *)buf;
-                int samples = read / 2;
-                int16_t *stereo = (int16_t *)malloc(samples * 4);
-
-                if (stereo)
-                {
-                    for (int i = 0; i < samples; i++)
-                    {
-                        int32_t amp = mono[i] * 3;
-                        if (amp > 32767)
-                            amp = 32767;
-                        if (amp < -32768)
-                            amp = -32768;
-
-                        int16_t s = (int16_t)amp;
-                        stereo[i * 2] = s;
-                        stereo[i * 2 + 1] = s;
-                    }
-                    i2s_write(SPK_PORT, stereo, samples * 4, &written, portMAX_DELAY);
-                    free(stereo);
-                }
+                int32_t k = min((faded + i) * 32768 / fadeFrames, 32768);
+                int32_t p0 = i < m ? fill[i * 2] : 0;
+                int32_t p1 = i < m ? fill[i * 2 + 1] : 0;
+                mix[i * 2] = (mix[i * 2] * k + p0 * (32768 - k)) >> 15;
+                mix[i * 2 + 1] = (mix[i * 2 + 1] * k + p1 * (32768 - k)) >> 15;
             }
-            else
+            faded += n;
+            if (faded >= fadeFrames || m < n)
             {
-                // Estéreo con amplificación
-                int16_t *samples = (int16_t *)buf;
-                int count = read / 2;
-                for (int i = 0; i < count; i++)
-                {
-                    int32_t amp = samples[i] * 3;
-                    if (amp > 32767)
-                        amp = 32767;
-                    if (amp < -32768)
-                        amp = -32768;
-                    samples[i] = (int16_t)amp;
-                }
-                i2s_write(SPK_PORT, buf, read, &written, portMAX_DELAY);
+                stopPrompt();
             }
         }
+        writeSamplesToSpeaker(mix, n * 2, 2);
     }
 
-    free(buf);
-    file.close();
+    response.close();
     delay(300);
     i2s_zero_dma_buffer(SPK_PORT);
 
@@ -446,122 +924,862 @@ void playAudioFromSD()
     isPlaying = false;
 }
 
+// ========== ESTIMACIÓN DEL ENLACE DE SUBIDA ==========
+UploadEstimate readUploadEstimate()
+{
+    portENTER_CRITICAL(&uploadEstimateMux);
+    UploadEstimate e = uploadEstimate;
+    portEXIT_CRITICAL(&uploadEstimateMux);
+    return e;
+}
+
+// Chunk confirmado: actualiza RTT (como TCP, 1/8 y 1/4), goodput, tamaño y
+// timeout. Solo crece si el chunk iba completo, para no premiar el final del
+// archivo.
+void uploadEstimateOnAck(uint32_t bytes, uint32_t rttMs)
+{
+    rttMs = max(rttMs, (uint32_t)1);
+    uint32_t bps = bytes * 1000 / rttMs;
+
+    portENTER_CRITICAL(&uploadEstimateMux);
+    UploadEstimate &e = uploadEstimate;
+    if (e.srttMs == 0)
+    {
+        e.srttMs = rttMs;
+        e.rttVarMs = rttMs / 2;
+        e.goodputBps = bps;
+    }
+    else
+    {
+        uint32_t err = rttMs > e.srttMs ? rttMs - e.srttMs : e.srttMs - rttMs;
+        e.rttVarMs = (3 * e.rttVarMs + err) / 4;
+        e.srttMs = (7 * e.srttMs + rttMs) / 8;
+        e.goodputBps = (7 * e.goodputBps + bps) / 8;
+    }
+
+    if (rttMs > UPLOAD_TARGET_RTT_MS)
+        e.chunkSize = max((e.chunkSize * 3 / 4) & ~255u, (uint32_t)UPLOAD_CHUNK_MIN);
+    else if (bytes >= e.chunkSize)
+        e.chunkSize = min(e.chunkSize + UPLOAD_CHUNK_STEP, (uint32_t)UPLOAD_CHUNK_MAX);
+
+    // El RTT suavizado viene de chunks de otros tamaños: el timeout cubre
+    // también el doble de lo que tardaría el chunk actual al goodput medido
+    uint32_t transferMs = e.goodputBps ? e.chunkSize * 1000 / e.goodputBps : 0;
+    uint32_t timeoutMs = max(e.srttMs + 4 * e.rttVarMs, UPLOAD_TIMEOUT_GOODPUT_FACTOR * transferMs);
+    e.timeoutMs = constrain(timeoutMs, (uint32_t)UPLOAD_TIMEOUT_MIN_MS, (uint32_t)UPLOAD_TIMEOUT_MAX_MS);
+    portEXIT_CRITICAL(&uploadEstimateMux);
+}
+
+// Timeout o error de conexión: chunk a la mitad y timeout al doble
+void uploadEstimateOnLoss()
+{
+    portENTER_CRITICAL(&uploadEstimateMux);
+    UploadEstimate &e = uploadEstimate;
+    e.chunkSize = max((e.chunkSize / 2) & ~255u, (uint32_t)UPLOAD_CHUNK_MIN);
+    e.timeoutMs = min(e.timeoutMs * 2, (uint32_t)UPLOAD_TIMEOUT_MAX_MS);
+    portEXIT_CRITICAL(&uploadEstimateMux);
+}
+
 // ========== ENVIAR AL SERVIDOR ==========
-void sendAudioToServer()
+// Sube la grabación del turno desde el último byte confirmado y guarda la
+// respuesta en su archivo. Un chunk rechazado se reintenta con espera
+// exponencial acotada; si se agotan los intentos o se cae el WiFi, el turno
+// queda incompleto para pasar al spool y reanudarse más tarde. El tamaño de
+// cada chunk y su timeout salen de la estimación del enlace.
+UploadResult sendAudioToServer(Turn &turn)
 {
-    File file = SD.open(recordingPath, FILE_READ);
+    File file = SD.open(turn.recordingPath, FILE_READ);
     if (!file)
     {
-        Serial.println("❌ Error abriendo grabación");
-        return;
+        Serial.printf("❌ [T%u] Error abriendo grabación\n", turn.id);
+        return UPLOAD_ERROR;
     }
 
     size_t fileSize = file.size();
-    Serial.printf("📦 Enviando %d bytes al servidor...\n", fileSize);
+    Serial.printf("📦 [T%u] Enviando %d bytes al servidor (desde %u)...\n",
+                  turn.id, fileSize, turn.ackedOffset);
 
-    size_t bytesSent = 0;
-    int chunkNum = 0;
-    const size_t CHUNK_SIZE = 4096;
-    uint8_t *buffer = (uint8_t *)malloc(CHUNK_SIZE);
+    uint8_t *buffer = (uint8_t *)malloc(UPLOAD_CHUNK_MAX);
 
     if (!buffer)
     {
         Serial.println("❌ Error malloc");
         file.close();
-        return;
+        return UPLOAD_ERROR;
     }
 
     HTTPClient http;
+    UploadResult result = UPLOAD_ERROR;
+    int attempt = 0;
 
-    while (file.available())
+    while (turn.ackedOffset < fileSize)
     {
-        int bytesRead = file.read(buffer, CHUNK_SIZE);
-        chunkNum++;
-        bool isLast = (bytesSent + bytesRead) >= fileSize;
+        if (WiFi.status() != WL_CONNECTED)
+        {
+            Serial.printf("📴 [T%u] Sin WiFi\n", turn.id);
+            result = UPLOAD_INCOMPLETE;
+            break;
+        }
+
+        UploadEstimate est = readUploadEstimate();
+        file.seek(turn.ackedOffset);
+        int bytesRead = file.read(buffer, est.chunkSize);
+        if (bytesRead <= 0)
+        {
+            Serial.printf("❌ [T%u] Error leyendo grabación\n", turn.id);
+            break;
+        }
+
+        uint32_t chunkNum = turn.ackedChunks + 1;
+        bool isLast = (turn.ackedOffset + bytesRead) >= fileSize;
 
         http.begin(String("http://") + serverIP + ":" + serverPort + "/audio");
         http.addHeader("Content-Type", "application/octet-stream");
         http.addHeader("X-Chunk-Number", String(chunkNum));
+        http.addHeader("X-Chunk-Offset", String(turn.ackedOffset));
         http.addHeader("X-Last-Chunk", isLast ? "true" : "false");
         http.addHeader("X-User-Id", userId);
-        http.setTimeout(isLast ? 60000 : 5000);
+        http.addHeader("X-Session-Id", String(turn.session));
+        http.addHeader("X-Turn-Id", String(turn.id));
+        http.addHeader("X-Sample-Rate", String(Audio::sampleRate));
+        http.addHeader("X-Bits-Per-Sample", String(Audio::bitsPerSample));
+        if (isLast)
+        {
+            http.addHeader("Accept", AUDIO_ACCEPT);
+        }
+        http.setTimeout(isLast ? UPLOAD_LAST_TIMEOUT_MS : est.timeoutMs);
 
+        uint32_t postStart = millis();
         int code = http.POST(buffer, bytesRead);
+        uint32_t rttMs = millis() - postStart;
+        traceUpload(turn.id, chunkNum, turn.ackedOffset, bytesRead, code, rttMs);
 
         if (code == 200)
         {
-            Serial.printf("✅ Chunk %d enviado\n", chunkNum);
+            // El RTT del último chunk incluye el backend, no mide el enlace
+            if (!isLast)
+                uploadEstimateOnAck(bytesRead, rttMs);
+            Serial.printf("✅ [T%u] Chunk %u enviado (%d bytes, %u ms)\n", turn.id, chunkNum, bytesRead, rttMs);
+            turn.ackedOffset += bytesRead;
+            turn.ackedChunks = chunkNum;
+            attempt = 0;
 
             if (isLast)
             {
-                Serial.println("📥 Recibiendo respuesta...");
-                SD.remove(responsePath);
-                File respFile = SD.open(responsePath, FILE_WRITE);
+                Serial.printf("📥 [T%u] Recibiendo respuesta...\n", turn.id);
+                SD.remove(turn.responsePath);
+                File respFile = SD.open(turn.responsePath, FILE_WRITE);
                 if (respFile)
                 {
-                    http.writeToStream(&respFile);
+                    uint32_t t0 = millis();
+                    TraceTeeStream tee(respFile, turn.id);
+                    int received = http.writeToStream(&tee);
                     respFile.close();
-                    Serial.println("✅ Respuesta guardada");
-                    playAudioFromSD();
+                    Serial.printf("✅ [T%u] Respuesta guardada (%d bytes en %lu ms)\n",
+                                  turn.id, received, (unsigned long)(millis() - t0));
+                    result = UPLOAD_OK;
                 }
             }
+            http.end();
+            continue;
         }
-        else
+
+        http.end();
+        Serial.printf("❌ [T%u] HTTP Error: %d (chunk %u, intento %d)\n",
+                      turn.id, code, chunkNum, attempt + 1);
+
+        // 4xx: el servidor rechaza la petición y repetirla no cambia nada,
+        // salvo 408 (timeout) y 429 (demasiadas peticiones)
+        if (code >= 400 && code < 500 && code != 408 && code != 429)
         {
-            Serial.printf("❌ HTTP Error: %d\n", code);
+            Serial.printf("⛔ [T%u] Rechazado por el servidor, no se reintenta\n", turn.id);
+            result = UPLOAD_ERROR;
+            break;
+        }
+
+        // Códigos negativos: timeout o conexión perdida (HTTPClient)
+        if (code < 0)
+            uploadEstimateOnLoss();
+
+        if (++attempt > MAX_CHUNK_RETRIES)
+        {
+            result = UPLOAD_INCOMPLETE;
+            break;
         }
-        http.end();
 
-        bytesSent += bytesRead;
+        uint32_t waitMs = min((uint32_t)RETRY_BASE_MS << (attempt - 1), (uint32_t)RETRY_MAX_MS);
+        delay(waitMs);
     }
 
     free(buffer);
     file.close();
+    return result;
 }
 
-// ========== RECIBIR AUDIO POR UART ==========
-void receiveAudioFromUART()
+// ========== SPOOL OFFLINE ==========
+// Los IDs de turno se repiten en cada arranque, así que los archivos del
+// spool se nombran con la sesión y el ID: s<sesión>_t<id>.pcm/.ack. Los
+// turnos guardados antes de X-Session-Id (sesión 0) conservan t<id>.
+struct SpoolEntry
 {
-    uint8_t buffer[256];
-    int len = uart_read_bytes(UART_NUM, buffer, sizeof(buffer), 10 / portTICK_PERIOD_MS);
+    uint32_t session;
+    uint32_t turnId;
+};
+
+void spoolPath(char *out, size_t size, const char *dir, uint32_t session, uint32_t turnId, const char *ext)
+{
+    if (session)
+        snprintf(out, size, "%s/s%08x_t%u.%s", dir, (unsigned)session, (unsigned)turnId, ext);
+    else
+        snprintf(out, size, "%s/t%u.%s", dir, (unsigned)turnId, ext);
+}
+
+// Mueve la grabación de un turno sin terminar al spool junto con su progreso.
+// Devuelve false si la grabación no se pudo mover (sigue en recordingPath).
+bool spoolTurn(Turn &turn)
+{
+    char pcmPath[48];
+    char ackPath[48];
+    spoolPath(pcmPath, sizeof(pcmPath), SPOOL_DIR, turn.session, turn.id, "pcm");
+    spoolPath(ackPath, sizeof(ackPath), SPOOL_DIR, turn.session, turn.id, "ack");
+
+    SD.mkdir(SPOOL_DIR);
+    SD.remove(pcmPath);
+    if (!SD.rename(turn.recordingPath, pcmPath))
+    {
+        Serial.printf("❌ [T%u] Error moviendo grabación al spool\n", turn.id);
+        return false;
+    }
+
+    SpoolMeta meta = {turn.id, turn.ackedOffset, turn.ackedChunks, turn.node, turn.spoolDrains, turn.session};
+    SD.remove(ackPath);
+    File ack = SD.open(ackPath, FILE_WRITE);
+    if (ack)
+    {
+        ack.write((const uint8_t *)&meta, sizeof(meta));
+        ack.close();
+    }
+
+    Serial.printf("💾 [T%u] Guardado en spool (%u bytes confirmados)\n", turn.id, turn.ackedOffset);
+    return true;
+}
+
+// Lee el progreso de un turno del spool. Sin archivo .ack se empieza de cero.
+SpoolMeta readSpoolMeta(const SpoolEntry &entry)
+{
+    uint32_t turnId = entry.turnId;
+    SpoolMeta meta = {turnId, 0, 0, 0, 0, entry.session};
+    char ackPath[48];
+    spoolPath(ackPath, sizeof(ackPath), SPOOL_DIR, entry.session, turnId, "ack");
 
-    if (len > 0)
+    File ack = SD.open(ackPath, FILE_READ);
+    if (ack)
     {
-        // Buscar comandos
-        String cmd = String((char *)buffer);
+        SpoolMeta stored = {0, 0, 0, 0, 0, 0};
+        int n = ack.read((uint8_t *)&stored, sizeof(stored));
+        if (n >= (int)offsetof(SpoolMeta, node) && stored.turnId == turnId)
+        {
+            meta = stored;
+            if (meta.node >= CAPTURE_NODES)
+                meta.node = 0;
+        }
+        ack.close();
+    }
+    return meta;
+}
+
+// Busca hasta `maxEntries` turnos en el spool. Devuelve cuántos encontró.
+// Con `entries` NULL solo los cuenta, sin límite.
+int listSpool(SpoolEntry *entries, int maxEntries)
+{
+    File dir = SD.open(SPOOL_DIR);
+    if (!dir || !dir.isDirectory())
+        return 0;
+
+    int count = 0;
+    File entry = dir.openNextFile();
+    while (entry && (!entries || count < maxEntries))
+    {
+        unsigned session = 0, id = 0;
+        const char *name = strrchr(entry.name(), '/');
+        name = name ? name + 1 : entry.name();
+        if (strstr(name, ".pcm") &&
+            (sscanf(name, "s%8x_t%u.pcm", &session, &id) == 2 || sscanf(name, "t%u.pcm", &id) == 1))
+        {
+            if (entries)
+                entries[count] = {session, id};
+            count++;
+        }
+        entry.close();
+        entry = dir.openNextFile();
+    }
+    dir.close();
+    return count;
+}
 
-        if (cmd.indexOf("START") >= 0 && !isReceiving)
+// ========== TAREAS DE LA COLA DE TURNOS ==========
+// Elige el siguiente turno a subir: un nodo tras otro (round-robin) y, dentro
+// de cada nodo, el turno más antiguo. Así una ráfaga de preguntas de un nodo
+// no retrasa las de los demás.
+int takeNextUpload()
+{
+    int slot = -1;
+    portENTER_CRITICAL(&turnsMux);
+    for (int n = 0; n < CAPTURE_NODES && slot < 0; n++)
+    {
+        int node = (nextUploadNode + n) % CAPTURE_NODES;
+        for (int i = 0; i < MAX_TURNS; i++)
         {
-            Serial.println("\n🔴 RECIBIENDO AUDIO...");
-            digitalWrite(LED_PIN, HIGH);
-            SD.remove(recordingPath);
-            audioFile = SD.open(recordingPath, FILE_WRITE);
-            if (audioFile)
+            if (turns[i].state == TURN_QUEUED && turns[i].node == node &&
+                (slot < 0 || turns[i].seq < turns[slot].seq))
             {
-                isReceiving = true;
+                slot = i;
+            }
+        }
+        if (slot >= 0)
+            nextUploadNode = (node + 1) % CAPTURE_NODES;
+    }
+    if (slot >= 0)
+        turns[slot].state = TURN_UPLOADING;
+    portEXIT_CRITICAL(&turnsMux);
+    return slot;
+}
+
+// Cada worker toma turnos terminados de la cola y los sube. Con más de un
+// worker el backend puede procesar un turno mientras se sube el siguiente.
+void uploadTask(void *param)
+{
+    while (true)
+    {
+        if (xSemaphoreTake(uploadSignal, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        int slot = takeNextUpload();
+        if (slot < 0)
+            continue;
+
+        Turn &turn = turns[slot];
+        turn.uploadMs = millis();
+
+        UploadResult result = sendAudioToServer(turn);
+        turn.upload = readUploadEstimate();
+
+        // La grabación solo se borra si ya no hace falta: subida completa o
+        // movida al spool. Si no, queda en SD hasta que se reutilice el slot.
+        if (result == UPLOAD_OK || (result == UPLOAD_INCOMPLETE && spoolTurn(turn)))
+        {
+            SD.remove(turn.recordingPath);
+        }
+        else
+        {
+            Serial.printf("⚠  [T%u] Grabación conservada en %s\n", turn.id, turn.recordingPath);
+        }
+
+        turn.responseMs = millis();
+        turn.state = (result == UPLOAD_OK) ? TURN_READY : TURN_FAILED;
+    }
+}
+
+// Telemetría por nodo tras cada turno: throughput del enlace al grabar,
+// espera en la cola de subida y espera por la bocina compartida.
+void printNodeStats(int n)
+{
+    CaptureNode &node = nodes[n];
+    if (node.turnsDone == 0)
+        return;
+
+    Serial.printf("📊 Nodo %d: %u turnos, %.1f KB/s recibidos, cola media %u ms (máx %u), "
+                  "bocina media %u ms (máx %u)\n",
+                  n + 1, node.turnsDone,
+                  node.bytesTotal / 1.024f / max(node.recordMsTotal, (uint32_t)1),
+                  node.queueMsTotal / node.turnsDone, node.queueMsMax,
+                  node.speakerMsTotal / node.turnsDone, node.speakerMsMax);
+}
+
+// Turno que toca reproducir en un nodo, o -1 si todavía no existe
+int headTurn(int node)
+{
+    for (int i = 0; i < MAX_TURNS; i++)
+    {
+        if (turns[i].state != TURN_FREE && turns[i].node == node && turns[i].seq == nodes[node].nextPlaySeq)
+            return i;
+    }
+    return -1;
+}
+
+// Reproduce las respuestas de cada nodo estrictamente en el orden de sus
+// turnos, aunque un turno posterior haya terminado de descargarse antes. Un
+// turno lento de un nodo no bloquea a los demás: la bocina se reparte entre
+// los nodos con respuesta lista. Mientras haya turnos en vuelo, llena el
+// silencio con earcons y prompts, salvo para los nodos que estén grabando.
+void playbackTask(void *param)
+{
+    while (true)
+    {
+        int slot = -1;
+        int waitingSlot = -1;
+        for (int n = 0; n < CAPTURE_NODES && slot < 0; n++)
+        {
+            int node = (nextPlayNode + n) % CAPTURE_NODES;
+            int head = headTurn(node);
+            if (head < 0)
+                continue;
+
+            TurnState state = turns[head].state;
+            if (state == TURN_READY || state == TURN_FAILED)
+            {
+                slot = head;
+                nextPlayNode = (node + 1) % CAPTURE_NODES;
+            }
+            else if ((state == TURN_QUEUED || state == TURN_UPLOADING) && !nodeRecording(node) &&
+                     (waitingSlot < 0 || turns[head].stopMs < turns[waitingSlot].stopMs))
+            {
+                waitingSlot = head;
+            }
+        }
+
+        if (slot >= 0)
+        {
+            Turn &turn = turns[slot];
+            CaptureNode &node = nodes[turn.node];
+            if (turn.state == TURN_READY)
+            {
+                uint32_t startMs = millis();
+                uint32_t queueMs = turn.uploadMs - turn.stopMs;
+                uint32_t speakerMs = startMs - turn.responseMs;
+                Serial.printf("⏱  [T%u] Nodo %d, STOP→respuesta: %lu ms, en cola: %u ms, en espera: %u ms\n",
+                              turn.id, turn.node + 1, (unsigned long)(turn.responseMs - turn.stopMs),
+                              queueMs, speakerMs);
+                Serial.printf("📶 [T%u] Subida: chunk %u bytes, RTT %u±%u ms, %.1f KB/s, timeout %u ms\n",
+                              turn.id, turn.upload.chunkSize, turn.upload.srttMs, turn.upload.rttVarMs,
+                              turn.upload.goodputBps / 1024.0f, turn.upload.timeoutMs);
+
+                node.turnsDone++;
+                node.queueMsTotal += queueMs;
+                node.queueMsMax = max(node.queueMsMax, queueMs);
+                node.speakerMsTotal += speakerMs;
+                node.speakerMsMax = max(node.speakerMsMax, speakerMs);
+                printNodeStats(turn.node);
+
+                tracePlayback(turn.id, TRACE_PLAY_START);
+                playAudioFromSD(turn.responsePath);
+                tracePlayback(turn.id, TRACE_PLAY_END);
+                SD.remove(turn.responsePath);
             }
             else
             {
-                Serial.println("❌ Error creando archivo");
+                Serial.printf("⚠  [T%u] Turno fallido, se omite\n", turn.id);
+                tracePlayback(turn.id, TRACE_PLAY_SKIP);
             }
+
+            portENTER_CRITICAL(&turnsMux);
+            turn.state = TURN_FREE;
+            node.nextPlaySeq++;
+            portEXIT_CRITICAL(&turnsMux);
+            continue;
         }
-        else if (cmd.indexOf("STOP") >= 0 && isReceiving)
+
+        if (earconsReady)
         {
-            Serial.println("✅ Recepción completa");
-            digitalWrite(LED_PIN, LOW);
-            isReceiving = false;
-            if (audioFile)
+            int ack = ackNode;
+            if (ack >= 0 && !nodeRecording(ack))
+            {
+                ackNode = -1;
+                if (promptActive)
+                    stopPrompt();
+                startPrompt(EARCON_ACK, ack);
+            }
+            else if (!promptActive && waitingSlot >= 0 && thinkingCount > 0 &&
+                     millis() - turns[waitingSlot].stopMs >= PROMPT_DELAY_MS &&
+                     millis() - lastPromptEndMs >= PROMPT_GAP_MS)
             {
-                audioFile.close();
+                startPrompt(thinkingPaths[nextThinking++ % thinkingCount], turns[waitingSlot].node);
+            }
+
+            if (promptActive)
+            {
+                pumpPrompt();
+                continue;
             }
-            Serial.println("⏳ Enviando a servidor...");
-            sendAudioToServer();
         }
-        else if (isReceiving && audioFile)
+
+        delay(20);
+    }
+}
+
+// Reserva un slot libre para un turno nuevo del nodo. Devuelve -1 si el nodo
+// ya tiene MAX_TURNS_PER_NODE turnos en vuelo, para que un nodo no deje sin
+// slots a los demás.
+int allocateTurn(int node)
+{
+    int slot = -1;
+    int inFlight = 0;
+    portENTER_CRITICAL(&turnsMux);
+    for (int i = 0; i < MAX_TURNS; i++)
+    {
+        if (turns[i].state == TURN_FREE)
         {
-            // Escribir datos de audio
-            audioFile.write(buffer, len);
+            if (slot < 0)
+                slot = i;
         }
+        else if (turns[i].node == node)
+        {
+            inFlight++;
+        }
+    }
+    if (inFlight >= MAX_TURNS_PER_NODE)
+        slot = -1;
+    if (slot >= 0)
+    {
+        turns[slot].state = TURN_RECORDING;
+        turns[slot].node = node;
+        turns[slot].seq = 0; // Se asigna al encolar
+    }
+    portEXIT_CRITICAL(&turnsMux);
+    return slot;
+}
+
+// Pone un turno terminado en la cola de subida con el siguiente número de
+// reproducción.
+void enqueueTurn(int slot)
+{
+    Turn &turn = turns[slot];
+    turn.stopMs = millis();
+
+    portENTER_CRITICAL(&turnsMux);
+    turn.seq = nodes[turn.node].nextQueueSeq++;
+    turn.state = TURN_QUEUED;
+    portEXIT_CRITICAL(&turnsMux);
+
+    xSemaphoreGive(uploadSignal);
+}
+
+// Aparta un turno que ya se ha reanudado demasiadas veces: se mueve a
+// SPOOL_BAD_DIR para poder revisarlo a mano y no se vuelve a subir.
+void quarantineSpooled(const SpoolEntry &entry)
+{
+    uint32_t turnId = entry.turnId;
+    char pcmPath[48];
+    char ackPath[48];
+    char badPath[48];
+    spoolPath(pcmPath, sizeof(pcmPath), SPOOL_DIR, entry.session, turnId, "pcm");
+    spoolPath(ackPath, sizeof(ackPath), SPOOL_DIR, entry.session, turnId, "ack");
+    spoolPath(badPath, sizeof(badPath), SPOOL_BAD_DIR, entry.session, turnId, "pcm");
+
+    SD.mkdir(SPOOL_BAD_DIR);
+    SD.remove(badPath);
+    if (!SD.rename(pcmPath, badPath))
+        SD.remove(pcmPath);
+    SD.remove(ackPath);
+    Serial.printf("🗑  [T%u] Apartado tras %d reanudaciones sin éxito\n", turnId, SPOOL_MAX_DRAINS);
+}
+
+// Re-encola un lote de turnos del spool cuando vuelve la conectividad.
+// Cada turno retoma la subida desde su último chunk confirmado; los que ya
+// se han reanudado SPOOL_MAX_DRAINS veces se apartan para no reintentar
+// siempre lo mismo.
+void drainSpool()
+{
+    static uint32_t lastCheckMs = 0;
+    if (millis() - lastCheckMs < SPOOL_CHECK_MS || WiFi.status() != WL_CONNECTED)
+        return;
+    lastCheckMs = millis();
+
+    SpoolEntry entries[SPOOL_BATCH];
+    int count = listSpool(entries, SPOOL_BATCH);
+
+    for (int i = 0; i < count; i++)
+    {
+        SpoolMeta meta = readSpoolMeta(entries[i]);
+        if (meta.drains >= SPOOL_MAX_DRAINS)
+        {
+            quarantineSpooled(entries[i]);
+            continue;
+        }
+
+        int slot = allocateTurn(meta.node);
+        if (slot < 0)
+            continue;
+
+        Turn &turn = turns[slot];
+        char pcmPath[48];
+        char ackPath[48];
+        spoolPath(pcmPath, sizeof(pcmPath), SPOOL_DIR, entries[i].session, entries[i].turnId, "pcm");
+        spoolPath(ackPath, sizeof(ackPath), SPOOL_DIR, entries[i].session, entries[i].turnId, "ack");
+
+        SD.remove(turn.recordingPath);
+        if (!SD.rename(pcmPath, turn.recordingPath))
+        {
+            turn.state = TURN_FREE;
+            continue;
+        }
+        SD.remove(ackPath);
+
+        turn.id = meta.turnId;
+        turn.session = meta.session; // 0: guardado antes de X-Session-Id
+        turn.ackedOffset = meta.ackedOffset;
+        turn.ackedChunks = meta.ackedChunks;
+        turn.spoolDrains = meta.drains + 1;
+        enqueueTurn(slot);
+        Serial.printf("📤 [T%u] Reanudando desde el spool (%u/%d)\n", turn.id, turn.spoolDrains, SPOOL_MAX_DRAINS);
+    }
+}
+
+void setupTurnQueue()
+{
+    for (int i = 0; i < MAX_TURNS; i++)
+    {
+        turns[i].state = TURN_FREE;
+        snprintf(turns[i].recordingPath, sizeof(turns[i].recordingPath), "/rec_%d.pcm", i);
+        snprintf(turns[i].responsePath, sizeof(turns[i].responsePath), "/resp_%d.wav", i);
+    }
+
+    // El contador de turnos empieza de nuevo en cada arranque; el backend
+    // distingue los turnos por (X-Session-Id, X-Turn-Id). La sesión 0 queda
+    // para los turnos del spool anteriores a X-Session-Id. Los archivos del
+    // spool llevan la sesión en el nombre, así que un turno nuevo nunca pisa
+    // uno guardado en otro arranque.
+    do
+    {
+        sessionId = esp_random();
+    } while (sessionId == 0);
+    Serial.printf("🆔 Sesión %u\n", sessionId);
+
+    int count = listSpool(NULL, 0);
+    if (count > 0)
+    {
+        Serial.printf("💾 %d turno(s) pendientes en el spool\n", count);
+    }
+
+    uploadSignal = xSemaphoreCreateCounting(MAX_TURNS, 0);
+
+    for (int i = 0; i < UPLOAD_WORKERS; i++)
+    {
+        xTaskCreatePinnedToCore(uploadTask, "upload", 8192, NULL, 1, NULL, 0);
+    }
+    xTaskCreatePinnedToCore(playbackTask, "playback", 4096, NULL, 2, NULL, 1);
+
+    Serial.printf("✅ Cola de turnos lista (%d nodos, %d turnos, %d subidas)\n",
+                  CAPTURE_NODES, MAX_TURNS, UPLOAD_WORKERS);
+}
+
+// ========== RECIBIR AUDIO DEL ENLACE ==========
+// Empieza la grabación de un turno del nodo. `rate` y `bits` son el formato
+// anunciado en START (0 si A no lo envía).
+void startRecording(int n, unsigned rate, unsigned bits)
+{
+    CaptureNode &node = nodes[n];
+
+    // A anuncia su formato; si no coincide, la grabación no sirve
+    if (rate && (rate != Audio::sampleRate || bits != Audio::bitsPerSample))
+    {
+        Serial.printf("❌ Formato del nodo %d (%u Hz/%u bits) distinto al de B (%u Hz/%u bits)\n",
+                      n + 1, rate, bits, (unsigned)Audio::sampleRate, (unsigned)Audio::bitsPerSample);
+        return;
+    }
+
+    int slot = allocateTurn(n);
+    if (slot < 0)
+    {
+        Serial.printf("⚠  Cola de turnos del nodo %d llena, se descarta la grabación\n", n + 1);
+        return;
+    }
+
+    Turn &turn = turns[slot];
+    SD.remove(turn.recordingPath);
+    node.file = SD.open(turn.recordingPath, FILE_WRITE);
+    if (!node.file)
+    {
+        turn.state = TURN_FREE;
+        Serial.println("❌ Error creando archivo");
+        return;
+    }
+
+    turn.id = nextTurnId++;
+    turn.session = sessionId;
+    turn.ackedOffset = 0;
+    turn.ackedChunks = 0;
+    turn.spoolDrains = 0;
+    node.recordingSlot = slot;
+    node.recordStartMs = millis();
+    node.lastRxMs = node.recordStartMs;
+    node.recordBytes = 0;
+    digitalWrite(LED_PIN, HIGH);
+    node.link->resetStats();
+    Serial.printf("\n🔴 [T%u] RECIBIENDO AUDIO del nodo %d...\n", turn.id, n + 1);
+}
+
+void writeRecording(CaptureNode &node, const uint8_t *data, size_t len)
+{
+    if (node.recordingSlot < 0 || !node.file || len == 0)
+        return;
+    node.file.write(data, len);
+    node.recordBytes += len;
+}
+
+// Cierra la grabación en curso del nodo y la pone en la cola de subida.
+// `stopped` es false si termina sin STOP (timeout o START nuevo): se sube lo
+// grabado, pero sin ack porque A no ha confirmado el final.
+void finishRecording(int n, bool stopped)
+{
+    CaptureNode &node = nodes[n];
+    int slot = node.recordingSlot;
+    Turn &turn = turns[slot];
+
+    // Lo retenido por si era un comando partido también es audio
+    writeRecording(node, node.cmdTail, node.cmdTailLen);
+    node.cmdTailLen = 0;
+
+    if (node.file)
+    {
+        node.file.close();
+    }
+    node.recordingSlot = -1;
+    digitalWrite(LED_PIN, anyNodeRecording() ? HIGH : LOW);
+
+    if (node.recordBytes == 0)
+    {
+        Serial.printf("⚠  [T%u] Grabación vacía del nodo %d, se descarta\n", turn.id, n + 1);
+        SD.remove(turn.recordingPath);
+        portENTER_CRITICAL(&turnsMux);
+        turn.state = TURN_FREE;
+        portEXIT_CRITICAL(&turnsMux);
+        return;
+    }
+
+    Serial.printf("✅ [T%u] Recepción %s (nodo %d, %u bytes)\n", turn.id,
+                  stopped ? "completa" : "cortada", n + 1, node.recordBytes);
+    node.link->printStats();
+    node.bytesTotal += node.recordBytes;
+    node.recordMsTotal += millis() - node.recordStartMs;
+
+    enqueueTurn(slot);
+
+    if (stopped && !isPlaying)
+    {
+        ackNode = n;
+    }
+    Serial.printf("⏳ [T%u] En cola para el servidor (%d pendientes)\n",
+                  turn.id, (int)uxSemaphoreGetCount(uploadSignal));
+}
+
+// Separa comandos y audio en los bytes recibidos de un nodo. Las lecturas
+// no respetan los límites de los comandos: STOP suele llegar pegado al
+// último chunk y un comando puede quedar partido entre dos lecturas. Los
+// comandos se buscan en los bytes crudos (el audio contiene ceros), lo que
+// va delante de un comando se escribe como audio y el final de cada lectura
+// se retiene en cmdTail hasta saber si empieza un comando.
+void parseLinkBytes(int n, const uint8_t *data, size_t size)
+{
+    CaptureNode &node = nodes[n];
+    const size_t startLen = strlen(LINK_CMD_START);
+    const size_t stopLen = strlen(LINK_CMD_STOP);
+    size_t pos = 0;
+    node.cmdTailLen = 0;
+
+    while (pos < size)
+    {
+        const uint8_t *start = (const uint8_t *)memmem(data + pos, size - pos, LINK_CMD_START, startLen);
+        const uint8_t *stop = (const uint8_t *)memmem(data + pos, size - pos, LINK_CMD_STOP, stopLen);
+        const uint8_t *cmd = (start && (!stop || start < stop)) ? start : stop;
+
+        if (!cmd)
+        {
+            // Sin comando: todo es audio salvo el final, que podría ser el
+            // principio de un comando que termina en la próxima lectura
+            size_t keep = min(size - pos, LINK_CMD_MAX_LEN - 1);
+            writeRecording(node, data + pos, size - pos - keep);
+            memcpy(node.cmdTail, data + size - keep, keep);
+            node.cmdTailLen = keep;
+            return;
+        }
+
+        size_t at = cmd - data;
+        writeRecording(node, data + pos, at - pos);
+
+        if (cmd == stop)
+        {
+            pos = at + stopLen;
+            if (node.recordingSlot >= 0)
+                finishRecording(n, true);
+            continue;
+        }
+
+        // "START <hz>/<bits>\n": hace falta la línea completa
+        size_t avail = min(size - at, LINK_CMD_MAX_LEN);
+        const uint8_t *nl = (const uint8_t *)memchr(cmd, '\n', avail);
+        if (!nl && size - at < LINK_CMD_MAX_LEN)
+        {
+            memcpy(node.cmdTail, cmd, size - at);
+            node.cmdTailLen = size - at;
+            return;
+        }
+
+        unsigned rate = 0, bits = 0;
+        if (nl)
+        {
+            char line[LINK_CMD_MAX_LEN + 1];
+            memcpy(line, cmd, nl - cmd);
+            line[nl - cmd] = 0;
+            if (sscanf(line, LINK_CMD_START " %u/%u", &rate, &bits) != 2)
+                rate = bits = 0;
+            pos = nl + 1 - data;
+        }
+        else
+        {
+            pos = at + startLen; // START sin formato
+        }
+
+        // START sin STOP previo: A se reinició a mitad, se sube lo que había
+        if (node.recordingSlot >= 0)
+            finishRecording(n, false);
+        startRecording(n, rate, bits);
+    }
+}
+
+void receiveFromNode(int n)
+{
+    CaptureNode &node = nodes[n];
+    static uint8_t work[LINK_CMD_MAX_LEN - 1 + LINK_READ_BYTES];
+
+    // Sin espera: un nodo callado no debe frenar la lectura de los demás
+    for (int reads = 0; reads < LINK_READS_PER_POLL; reads++)
+    {
+        size_t tail = node.cmdTailLen;
+        int len = node.link->receive(work + tail, LINK_READ_BYTES, 0);
+        if (len <= 0)
+            return;
+
+        traceLinkRx(n, work + tail, len);
+        if (node.recordingSlot >= 0)
+            node.lastRxMs = millis();
+
+        memcpy(work, node.cmdTail, tail);
+        parseLinkBytes(n, work, tail + len);
+    }
+}
+
+// Cierra la grabación de un nodo que dejó de enviar sin STOP (reinicio,
+// pérdida del enlace) y sube lo grabado, para que no bloquee su cola ni
+// silencie sus prompts indefinidamente.
+void checkRecordingTimeout(int n)
+{
+    CaptureNode &node = nodes[n];
+    if (node.recordingSlot < 0 || millis() - node.lastRxMs < RECORD_IDLE_TIMEOUT_MS)
+        return;
+
+    Serial.printf("⚠  [T%u] Nodo %d sin datos durante %d ms, se cierra la grabación\n",
+                  turns[node.recordingSlot].id, n + 1, RECORD_IDLE_TIMEOUT_MS);
+    finishRecording(n, false);
+}
+
+// Atiende a todos los nodos de captura en cada pasada
+void receiveAudioFromLink()
+{
+    for (int n = 0; n < CAPTURE_NODES; n++)
+    {
+        receiveFromNode(n);
+        checkRecordingTimeout(n);
     }
 }
 
@@ -598,13 +1816,19 @@ void loop()
         shutdownBLE();
         delay(1000);
         initializeHardware();
+        setupEarcons();
+        setupTurnQueue();
         return;
     }
 
-    // Procesar audio recibido por UART
-    if (systemReady && !isPlaying)
+    // Procesar audio recibido del enlace (también durante subidas y reproducción)
+    if (systemReady)
     {
-        receiveAudioFromUART();
+        receiveAudioFromLink();
+
+        // No espera a que terminen las grabaciones: solo mueve archivos cada
+        // SPOOL_CHECK_MS y el buffer del enlace absorbe la pausa
+        drainSpool();
     }
 
     delay(5);
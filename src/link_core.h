@@ -0,0 +1,225 @@
+/* Núcleo portable del enlace A ↔ B
+
+   LinkTransport (contabilidad común de todos los backends) y
+   LoopbackTransport no dependen del hardware: compilan en el ESP32 y en el
+   host, donde los usa test/test_link_loopback. Los backends UART y ESP-NOW
+   están en link_transport.h.
+
+   Las estadísticas se pueden actualizar desde otra tarea (el callback de
+   recepción de ESP-NOW corre en la tarea de WiFi), así que toda escritura y
+   lectura pasa por un cerrojo: portMUX en el ESP32, std::mutex en el host.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <algorithm>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+struct LinkLock
+{
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+    void lock() { portENTER_CRITICAL(&mux); }
+    void unlock() { portEXIT_CRITICAL(&mux); }
+};
+
+inline uint32_t linkMillis() { return millis(); }
+inline uint32_t linkMicros() { return micros(); }
+#else
+#include <chrono>
+#include <mutex>
+
+struct LinkLock
+{
+    std::mutex mutex;
+    void lock() { mutex.lock(); }
+    void unlock() { mutex.unlock(); }
+};
+
+inline uint32_t linkMicros()
+{
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+inline uint32_t linkMillis() { return linkMicros() / 1000; }
+#endif
+
+#define LINK_BACKEND_UART 0
+#define LINK_BACKEND_ESPNOW 1
+#define LINK_BACKEND_LOOPBACK 2 // Solo pruebas de host: no tiene nodo remoto
+
+struct LinkStats
+{
+    uint32_t bytesTx;
+    uint32_t bytesRx;
+    uint32_t bytesLost;
+    uint32_t sendCalls;
+    uint32_t latencyUsTotal;
+    uint32_t latencyUsMax;
+    uint32_t startMs;
+};
+
+class LinkTransport
+{
+public:
+    LinkTransport() { resetStats(); }
+    virtual ~LinkTransport() {}
+
+    virtual const char *name() const = 0;
+    virtual bool begin() = 0;
+
+    // Qué mide la latencia de send() en este backend. No es lo mismo en
+    // todos: UART termina al copiar al buffer TX del driver, ESP-NOW al
+    // recibir la confirmación por radio de cada trama.
+    virtual const char *latencyMeaning() const = 0;
+
+    // Entrega lo que el backend tenga acumulado (comandos, fin de chunk)
+    virtual void flush() {}
+
+    int send(const uint8_t *data, size_t len)
+    {
+        uint32_t t0 = linkMicros();
+        int sent = writeRaw(data, len);
+        uint32_t us = linkMicros() - t0;
+
+        statsLock.lock();
+        stats.sendCalls++;
+        stats.latencyUsTotal += us;
+        if (us > stats.latencyUsMax)
+            stats.latencyUsMax = us;
+
+        if (sent > 0)
+            stats.bytesTx += sent;
+        if (sent < (int)len)
+            stats.bytesLost += len - (std::max)(sent, 0);
+        statsLock.unlock();
+        return sent;
+    }
+
+    int receive(uint8_t *buf, size_t len, uint32_t timeoutMs)
+    {
+        int n = readRaw(buf, len, timeoutMs);
+        if (n > 0)
+        {
+            statsLock.lock();
+            stats.bytesRx += n;
+            statsLock.unlock();
+        }
+        return n;
+    }
+
+    void resetStats()
+    {
+        statsLock.lock();
+        memset(&stats, 0, sizeof(stats));
+        stats.startMs = linkMillis();
+        statsLock.unlock();
+    }
+
+    LinkStats readStats()
+    {
+        statsLock.lock();
+        LinkStats s = stats;
+        statsLock.unlock();
+        return s;
+    }
+
+    // Resumen en una línea: throughput, pérdidas y latencia
+    void formatStats(char *out, size_t size)
+    {
+        LinkStats s = readStats();
+        uint32_t elapsed = (std::max)(linkMillis() - s.startMs, (uint32_t)1);
+        uint32_t total = s.bytesTx + s.bytesRx + s.bytesLost;
+        snprintf(out, size,
+                 "Enlace %s: TX %.1f KB/s, RX %.1f KB/s, pérdidas %u bytes (%.2f%%), "
+                 "latencia (%s) media %u us, máx %u us",
+                 name(), s.bytesTx / 1.024f / elapsed, s.bytesRx / 1.024f / elapsed,
+                 (unsigned)s.bytesLost, total ? s.bytesLost * 100.0f / total : 0.0f,
+                 latencyMeaning(), (unsigned)(s.sendCalls ? s.latencyUsTotal / s.sendCalls : 0),
+                 (unsigned)s.latencyUsMax);
+    }
+
+#ifdef ARDUINO
+    void printStats()
+    {
+        char line[192];
+        formatStats(line, sizeof(line));
+        Serial.printf("📶 %s\n", line);
+    }
+#endif
+
+protected:
+    virtual int writeRaw(const uint8_t *data, size_t len) = 0;
+    virtual int readRaw(uint8_t *buf, size_t len, uint32_t timeoutMs) = 0;
+
+    // Para pérdidas detectadas fuera de send() (p. ej. desde un callback)
+    void countLost(uint32_t bytes)
+    {
+        statsLock.lock();
+        stats.bytesLost += bytes;
+        statsLock.unlock();
+    }
+
+private:
+    LinkStats stats;
+    LinkLock statsLock;
+};
+
+// ========== LOOPBACK ==========
+// Buffer circular en memoria: receive() devuelve lo que se envió con send().
+// Los dos extremos del enlace son el mismo objeto, así que solo sirve para
+// pruebas en un mismo programa (test/test_link_loopback), no para enlazar
+// dos ESP32.
+class LoopbackTransport : public LinkTransport
+{
+public:
+    explicit LoopbackTransport(size_t capacity) : capacity(capacity) {}
+    ~LoopbackTransport() { free(ring); }
+
+    const char *name() const { return "Loopback"; }
+    const char *latencyMeaning() const { return "copia al buffer"; }
+
+    bool begin()
+    {
+        free(ring);
+        ring = (uint8_t *)malloc(capacity);
+        head = tail = count = 0;
+        return ring != NULL;
+    }
+
+protected:
+    int writeRaw(const uint8_t *data, size_t len)
+    {
+        size_t n = (std::min)(len, capacity - count);
+        for (size_t i = 0; i < n; i++)
+        {
+            ring[head] = data[i];
+            head = (head + 1) % capacity;
+        }
+        count += n;
+        return n;
+    }
+
+    int readRaw(uint8_t *buf, size_t len, uint32_t)
+    {
+        size_t n = (std::min)(len, count);
+        for (size_t i = 0; i < n; i++)
+        {
+            buf[i] = ring[tail];
+            tail = (tail + 1) % capacity;
+        }
+        count -= n;
+        return n;
+    }
+
+private:
+    uint8_t *ring = NULL;
+    size_t capacity;
+    size_t head = 0, tail = 0, count = 0;
+};
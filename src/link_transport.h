@@ -0,0 +1,248 @@
+/* Transporte entre ESP32 A y ESP32 B
+
+   Backends:
+   - UartTransport:     UART2 por cable (el enlace original)
+   - EspNowTransport:   inalámbrico, agrupa los datos en tramas de 250 bytes
+                        con número de secuencia para detectar pérdidas
+   - LoopbackTransport: en memoria, para pruebas de host (link_core.h)
+
+   Todos se usan a través de send()/receive() de LinkTransport, que mide
+   igual para cualquier backend:
+   - Throughput: bytes enviados/recibidos por segundo desde resetStats()
+   - Pérdidas:   bytes que el backend no pudo entregar o que el receptor
+                 detectó como faltantes (tramas de ESP-NOW sin llegar,
+                 desbordamientos de la FIFO del UART)
+   - Latencia:   tiempo dentro de send(). No es comparable entre backends:
+                 en UART es la copia al buffer TX del driver (el envío por el
+                 cable sigue en segundo plano); en ESP-NOW incluye la
+                 confirmación por radio de cada trama. printStats() indica
+                 qué mide cada uno.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include "link_core.h"
+#include "driver/uart.h"
+#include <WiFi.h>
+#include <esp_now.h>
+#include <esp_wifi.h>
+#include <freertos/stream_buffer.h>
+
+#define LINK_ESPNOW_FRAME 250 // ESP_NOW_MAX_DATA_LEN
+#define LINK_ESPNOW_HEADER 2  // Número de secuencia (uint16 LE)
+#define LINK_ESPNOW_PAYLOAD (LINK_ESPNOW_FRAME - LINK_ESPNOW_HEADER)
+#define LINK_ESPNOW_ACK_MS 50 // Espera máxima de confirmación por trama
+
+// ========== UART ==========
+// Pérdidas: sin control de flujo, si B no lee a tiempo se llena el buffer
+// del driver y después la FIFO del UART, que el driver vacía al desbordarse
+// (UART_FIFO_OVF). Cada desbordamiento se cuenta como una FIFO completa
+// perdida, una estimación como la de las tramas que faltan en ESP-NOW.
+#define LINK_UART_EVENTS 16 // Cola de eventos del driver UART
+
+class UartTransport : public LinkTransport
+{
+public:
+    UartTransport(uart_port_t port, int txPin, int rxPin, int baud, int rxBuffer, int txBuffer)
+        : port(port), txPin(txPin), rxPin(rxPin), baud(baud), rxBuffer(rxBuffer), txBuffer(txBuffer) {}
+
+    const char *name() const { return "UART"; }
+    const char *latencyMeaning() const { return "copia al buffer TX"; }
+
+    bool begin()
+    {
+        uart_config_t uart_config = {
+            .baud_rate = baud,
+            .data_bits = UART_DATA_8_BITS,
+            .parity = UART_PARITY_DISABLE,
+            .stop_bits = UART_STOP_BITS_1,
+            .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+            .rx_flow_ctrl_thresh = 122,
+            .source_clk = UART_SCLK_APB,
+        };
+
+        if (uart_driver_install(port, rxBuffer, txBuffer, LINK_UART_EVENTS, &events, 0) != ESP_OK)
+            return false;
+        uart_param_config(port, &uart_config);
+        uart_set_pin(port, txPin, rxPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+        return true;
+    }
+
+protected:
+    int writeRaw(const uint8_t *data, size_t len)
+    {
+        return uart_write_bytes(port, (const char *)data, len);
+    }
+
+    int readRaw(uint8_t *buf, size_t len, uint32_t timeoutMs)
+    {
+        countOverflows();
+        return uart_read_bytes(port, buf, len, timeoutMs / portTICK_PERIOD_MS);
+    }
+
+private:
+    uart_port_t port;
+    int txPin, rxPin, baud, rxBuffer, txBuffer;
+    QueueHandle_t events = NULL;
+
+    // Atiende los eventos del driver sin esperar. UART_BUFFER_FULL aún no
+    // pierde datos (quedan en la FIFO); se pierden en el UART_FIFO_OVF que
+    // le sigue si B no lee.
+    void countOverflows()
+    {
+        uart_event_t event;
+        while (events && xQueueReceive(events, &event, 0) == pdTRUE)
+        {
+            if (event.type == UART_FIFO_OVF)
+                countLost(UART_FIFO_LEN);
+        }
+    }
+};
+
+// ========== ESP-NOW ==========
+// Los datos se agrupan en tramas de hasta 248 bytes útiles. Cada trama espera
+// su confirmación antes de la siguiente para no saturar la cola de ESP-NOW.
+// Ambos nodos deben estar en el mismo canal WiFi (el del AP de B).
+class EspNowTransport : public LinkTransport
+{
+public:
+    EspNowTransport(const uint8_t peerMac[6], uint8_t channel, size_t rxBuffer)
+        : channel(channel), rxBufferSize(rxBuffer)
+    {
+        memcpy(peer, peerMac, 6);
+    }
+
+    const char *name() const { return "ESP-NOW"; }
+    const char *latencyMeaning() const { return "confirmación por radio"; }
+
+    bool begin()
+    {
+        instance = this;
+
+        WiFi.mode(WIFI_STA);
+        // Con WiFi conectado el canal lo fija el AP
+        if (WiFi.status() != WL_CONNECTED)
+        {
+            esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
+        }
+
+        if (esp_now_init() != ESP_OK)
+            return false;
+
+        rx = xStreamBufferCreate(rxBufferSize, 1);
+        txDone = xSemaphoreCreateBinary();
+        if (!rx || !txDone)
+            return false;
+
+        esp_now_register_send_cb(onSent);
+        esp_now_register_recv_cb(onReceived);
+
+        esp_now_peer_info_t info = {};
+        memcpy(info.peer_addr, peer, 6);
+        info.channel = 0; // Canal actual
+        info.encrypt = false;
+        return esp_now_add_peer(&info) == ESP_OK;
+    }
+
+    void flush()
+    {
+        if (frameLen > LINK_ESPNOW_HEADER)
+        {
+            int payload = frameLen - LINK_ESPNOW_HEADER;
+            if (!sendFrame())
+                countLost(payload);
+        }
+    }
+
+protected:
+    int writeRaw(const uint8_t *data, size_t len)
+    {
+        int delivered = 0;
+        size_t offset = 0;
+
+        while (offset < len)
+        {
+            if (frameLen == 0)
+            {
+                frame[0] = txSeq & 0xFF;
+                frame[1] = txSeq >> 8;
+                frameLen = LINK_ESPNOW_HEADER;
+            }
+
+            size_t n = min(len - offset, (size_t)(LINK_ESPNOW_FRAME - frameLen));
+            memcpy(frame + frameLen, data + offset, n);
+            frameLen += n;
+            offset += n;
+            delivered += n;
+
+            if (frameLen == LINK_ESPNOW_FRAME && !sendFrame())
+                delivered -= LINK_ESPNOW_PAYLOAD;
+        }
+        return max(delivered, 0);
+    }
+
+    int readRaw(uint8_t *buf, size_t len, uint32_t timeoutMs)
+    {
+        return xStreamBufferReceive(rx, buf, len, pdMS_TO_TICKS(timeoutMs));
+    }
+
+private:
+    static EspNowTransport *instance; // Para los callbacks de ESP-NOW
+
+    uint8_t peer[6];
+    uint8_t channel;
+    size_t rxBufferSize;
+    StreamBufferHandle_t rx = NULL;
+    SemaphoreHandle_t txDone = NULL;
+    volatile bool txOk = false;
+
+    uint8_t frame[LINK_ESPNOW_FRAME];
+    size_t frameLen = 0;
+    uint16_t txSeq = 0;
+
+    bool haveRxSeq = false;
+    uint16_t rxSeq = 0;
+
+    bool sendFrame()
+    {
+        xSemaphoreTake(txDone, 0);
+        bool ok = esp_now_send(peer, frame, frameLen) == ESP_OK &&
+                  xSemaphoreTake(txDone, pdMS_TO_TICKS(LINK_ESPNOW_ACK_MS)) == pdTRUE &&
+                  txOk;
+        frameLen = 0;
+        txSeq++;
+        return ok;
+    }
+
+    static void onSent(const uint8_t *mac, esp_now_send_status_t status)
+    {
+        instance->txOk = (status == ESP_NOW_SEND_SUCCESS);
+        xSemaphoreGive(instance->txDone);
+    }
+
+    static void onReceived(const uint8_t *mac, const uint8_t *data, int len)
+    {
+        if (len <= LINK_ESPNOW_HEADER)
+            return;
+
+        EspNowTransport *self = instance;
+        uint16_t seq = data[0] | (data[1] << 8);
+        if (self->haveRxSeq && seq != (uint16_t)(self->rxSeq + 1))
+        {
+            // Tramas faltantes, estimadas como tramas completas
+            uint16_t missing = seq - self->rxSeq - 1;
+            self->countLost(missing * LINK_ESPNOW_PAYLOAD);
+        }
+        self->rxSeq = seq;
+        self->haveRxSeq = true;
+
+        size_t payload = len - LINK_ESPNOW_HEADER;
+        size_t stored = xStreamBufferSend(self->rx, data + LINK_ESPNOW_HEADER, payload, 0);
+        if (stored < payload)
+            self->countLost(payload - stored);
+    }
+};
+
+// Fuera de la clase: el core de Arduino compila con gnu++11 (sin inline)
+EspNowTransport *EspNowTransport::instance = NULL;
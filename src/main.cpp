@@ -2,27 +2,25 @@
 
 // =================================================================================
 // SELECCIÓN DE FIRMWARE
-// Descomenta la línea correspondiente al dispositivo que deseas programar.
-// =================================================================================
-
-// OPCIÓN A: ESP32 A (Capturador de Audio - NodeMCU-32S)
+// El firmware lo define el entorno de platformio.ini:
+//
+// env:capture   → FIRMWARE_A_CAPTURE (ESP32 A - NodeMCU-32S)
 // - Conectado al Micrófono INMP441
 // - Envía audio por UART al ESP32 B
-// #define FIRMWARE_A_CAPTURE
-
-// OPCIÓN B: ESP32 B (Procesador - LilyGo T-SIM7000G)
+//
+// env:processor → FIRMWARE_B_PROCESSOR (ESP32 B - LilyGo T-SIM7000G)
 // - Conectado a SD, WiFi, Bocina MAX98357A
 // - Recibe audio por UART, guarda en SD, envía a Backend
-#define FIRMWARE_B_PROCESSOR
-
+//
+// Los entornos *_8k compilan ambos con audio de 8 kHz.
 // =================================================================================
 
 #if defined(FIRMWARE_A_CAPTURE) && defined(FIRMWARE_B_PROCESSOR)
-#error "Solo puedes seleccionar un firmware a la vez. Comenta una de las opciones."
+#error "Solo puedes seleccionar un firmware a la vez. Revisa build_flags en platformio.ini."
 #endif
 
 #if !defined(FIRMWARE_A_CAPTURE) && !defined(FIRMWARE_B_PROCESSOR)
-#error "Debes seleccionar un firmware (A o B) descomentando una de las opciones."
+#error "Compila con un entorno de platformio.ini (capture o processor)."
 #endif
 
 #ifdef FIRMWARE_A_CAPTURE
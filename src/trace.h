@@ -0,0 +1,207 @@
+/* Traza binaria del enlace y del pipeline (ESP32 B)
+
+   Con TRACE_ENABLED, B guarda en la SD (TRACE_PATH) todo lo que pasa en
+   cada turno para poder reproducirlo después con tools/trace_replay.py.
+
+   Formato (little-endian):
+   Cabecera: "MZTR" | versión u8 | sample_rate u32 | bits u8
+   Registro: tipo u8 | t_ms u32 (desde el inicio de la traza) | len u16 | datos
+
+   Tipos:
+   - TRACE_LINK_RX   nodo u8 | bytes tal cual llegaron del enlace de ese nodo
+   - TRACE_UPLOAD    turn u32 | chunk u32 | offset u32 | size u16 | code i16 | ms u32
+   - TRACE_RESPONSE  turn u32 | bytes de la respuesta (en trozos)
+   - TRACE_PLAYBACK  turn u32 | evento u8 (TRACE_PLAY_*)
+
+   Los registros se acumulan en RAM y se escriben a la SD por bloques; se
+   puede llamar desde loop() y desde las tareas de subida y reproducción.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include "SD.h"
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 0
+#endif
+
+#define TRACE_PATH "/trace.bin"
+#define TRACE_VERSION 2 // v2: nodo de captura en TRACE_LINK_RX
+#define TRACE_BUFFER 4096
+#define TRACE_MAX_BYTES (64UL * 1024 * 1024) // Se deja de trazar al llegar aquí
+
+#define TRACE_LINK_RX 1
+#define TRACE_UPLOAD 2
+#define TRACE_RESPONSE 3
+#define TRACE_PLAYBACK 4
+
+#define TRACE_PLAY_START 1
+#define TRACE_PLAY_END 2
+#define TRACE_PLAY_SKIP 3
+
+#if TRACE_ENABLED
+
+struct TraceState
+{
+    File file;
+    SemaphoreHandle_t lock;
+    uint8_t buffer[TRACE_BUFFER];
+    size_t used;
+    uint32_t written;
+    uint32_t startMs;
+    bool active;
+};
+
+TraceState trace;
+
+inline void traceFlushLocked()
+{
+    if (trace.used > 0)
+    {
+        trace.file.write(trace.buffer, trace.used);
+        trace.file.flush();
+        trace.written += trace.used;
+        trace.used = 0;
+    }
+}
+
+inline void traceBegin(uint32_t sampleRate, uint8_t bits)
+{
+    trace.lock = xSemaphoreCreateMutex();
+    SD.remove(TRACE_PATH);
+    trace.file = SD.open(TRACE_PATH, FILE_WRITE);
+    if (!trace.file || !trace.lock)
+    {
+        Serial.println("❌ Error creando traza");
+        return;
+    }
+
+    uint8_t header[10] = {'M', 'Z', 'T', 'R', TRACE_VERSION,
+                          (uint8_t)sampleRate, (uint8_t)(sampleRate >> 8),
+                          (uint8_t)(sampleRate >> 16), (uint8_t)(sampleRate >> 24), bits};
+    trace.file.write(header, sizeof(header));
+    trace.used = 0;
+    trace.written = sizeof(header);
+    trace.startMs = millis();
+    trace.active = true;
+    Serial.printf("✅ Traza activa en %s\n", TRACE_PATH);
+}
+
+// Añade un registro con dos partes de datos (cabecera del evento + payload)
+inline void traceRecord(uint8_t type, const void *meta, size_t metaLen, const void *data, size_t dataLen)
+{
+    if (!trace.active)
+        return;
+
+    size_t len = metaLen + dataLen;
+    size_t total = 7 + len;
+    if (len > 0xFFFF || total > TRACE_BUFFER)
+        return;
+
+    xSemaphoreTake(trace.lock, portMAX_DELAY);
+
+    if (trace.written + trace.used + total > TRACE_MAX_BYTES)
+    {
+        traceFlushLocked();
+        trace.file.close();
+        trace.active = false;
+        xSemaphoreGive(trace.lock);
+        Serial.println("⚠  Traza llena, se detiene");
+        return;
+    }
+
+    if (trace.used + total > TRACE_BUFFER)
+        traceFlushLocked();
+
+    uint32_t t = millis() - trace.startMs;
+    uint8_t *p = trace.buffer + trace.used;
+    p[0] = type;
+    memcpy(p + 1, &t, 4);
+    p[5] = len & 0xFF;
+    p[6] = len >> 8;
+    memcpy(p + 7, meta, metaLen);
+    memcpy(p + 7 + metaLen, data, dataLen);
+    trace.used += total;
+
+    xSemaphoreGive(trace.lock);
+}
+
+inline void traceFlush()
+{
+    if (!trace.active)
+        return;
+    xSemaphoreTake(trace.lock, portMAX_DELAY);
+    traceFlushLocked();
+    xSemaphoreGive(trace.lock);
+}
+
+inline void traceLinkRx(uint8_t node, const uint8_t *data, size_t len)
+{
+    traceRecord(TRACE_LINK_RX, &node, 1, data, len);
+}
+
+inline void traceUpload(uint32_t turnId, uint32_t chunk, uint32_t offset, uint16_t size, int16_t code, uint32_t ms)
+{
+    uint8_t meta[20];
+    memcpy(meta, &turnId, 4);
+    memcpy(meta + 4, &chunk, 4);
+    memcpy(meta + 8, &offset, 4);
+    memcpy(meta + 12, &size, 2);
+    memcpy(meta + 14, &code, 2);
+    memcpy(meta + 16, &ms, 4);
+    traceRecord(TRACE_UPLOAD, meta, sizeof(meta), NULL, 0);
+}
+
+inline void traceResponse(uint32_t turnId, const uint8_t *data, size_t len)
+{
+    // En trozos para que cada registro quepa en el buffer
+    while (len > 0)
+    {
+        size_t n = min(len, (size_t)1024);
+        traceRecord(TRACE_RESPONSE, &turnId, 4, data, n);
+        data += n;
+        len -= n;
+    }
+}
+
+inline void tracePlayback(uint32_t turnId, uint8_t event)
+{
+    traceRecord(TRACE_PLAYBACK, &turnId, 4, &event, 1);
+    traceFlush();
+}
+
+#else
+
+inline void traceBegin(uint32_t sampleRate, uint8_t bits) {}
+inline void traceFlush() {}
+inline void traceLinkRx(uint8_t node, const uint8_t *data, size_t len) {}
+inline void traceUpload(uint32_t turnId, uint32_t chunk, uint32_t offset, uint16_t size, int16_t code, uint32_t ms) {}
+inline void traceResponse(uint32_t turnId, const uint8_t *data, size_t len) {}
+inline void tracePlayback(uint32_t turnId, uint8_t event) {}
+
+#endif
+
+// Copia lo que escribe HTTPClient::writeToStream() a la respuesta y a la traza
+class TraceTeeStream : public Stream
+{
+public:
+    TraceTeeStream(File &out, uint32_t turnId) : out(out), turnId(turnId) {}
+
+    size_t write(const uint8_t *data, size_t len)
+    {
+        size_t n = out.write(data, len);
+        traceResponse(turnId, data, n);
+        return n;
+    }
+
+    size_t write(uint8_t b) { return write(&b, 1); }
+    int available() { return 0; }
+    int read() { return -1; }
+    int peek() { return -1; }
+    void flush() { out.flush(); }
+
+private:
+    File &out;
+    uint32_t turnId;
+};
@@ -0,0 +1,370 @@
+/* Pruebas de la cadena DSP de captura (src/capture_dsp.h)
+
+   Cada etapa en punto fijo se compara con una referencia en double que
+   implementa la misma ecuación sin cuantizar. Las cotas de error están
+   en LSB de la escala de la prueba (16 bits, o 24 bits con levelShift 8):
+
+   - HPF:   error por truncado del estado (2^-hpfFracBits por muestra,
+            acumulado por 1/(1-a) ≈ 200) más el truncado de la salida
+   - Gate:  las decisiones de umbral y hold pueden desfasarse unas
+            muestras; la cota es de 8 pasos de rampa de ganancia
+   - AGC:   ganancia en Q8 y paso de interpolación en Q16
+   - Budget: el contador de ciclos se simula para forzar la caída y la
+            recuperación de etapas en dspUpdateBudget()
+
+   Host:   pio test -e native
+*/
+
+#include <unity.h>
+#include <math.h>
+#include "../../src/capture_dsp.h"
+
+#define RATE 16000
+#define CHUNK 2048 // 128 ms a 16 kHz
+#define CHUNKS 64 // ~8 s: 6 ráfagas de voz
+#define COEFF_16K 32604
+
+static int32_t input[CHUNK * CHUNKS];
+static int32_t fixedOut[CHUNK * CHUNKS];
+static double refOut[CHUNK * CHUNKS];
+
+// ========== SEÑALES DE PRUEBA ==========
+static uint32_t lcg = 1;
+static int32_t noise(int32_t amplitude)
+{
+    lcg = lcg * 1664525u + 1013904223u;
+    return (int32_t)((int64_t)((int32_t)(lcg >> 8) - (1 << 23)) * amplitude >> 23);
+}
+
+// Voz simulada: ráfagas de tono de 0.5 s separadas por 1 s de ruido de
+// fondo, con offset DC como el del INMP441
+static void makeSpeech(int shift, int32_t amplitude, int32_t dc)
+{
+    lcg = 1;
+    for (int i = 0; i < CHUNK * CHUNKS; i++)
+    {
+        bool voiced = i % (RATE * 3 / 2) < RATE / 2;
+        double tone = sin(2 * M_PI * 440.0 * i / RATE) + 0.3 * sin(2 * M_PI * 1250.0 * i / RATE);
+        int32_t s = voiced ? (int32_t)(amplitude * tone / 1.3) : noise(60);
+        input[i] = (s + dc) << shift;
+    }
+}
+
+static double maxError(int from)
+{
+    double err = 0;
+    for (int i = from; i < CHUNK * CHUNKS; i++)
+        err = fmax(err, fabs(fixedOut[i] - refOut[i]));
+    return err;
+}
+
+static uint32_t fakeCycles = 0;
+static uint32_t fakeStageCost = 0;
+static uint32_t fakeCounter()
+{
+    fakeCycles += fakeStageCost;
+    return fakeCycles;
+}
+
+static DspChain dsp;
+
+static void runStage(const DspConfig &cfg, void (*stage)(DspChain &, int32_t *, int))
+{
+    dspInit(dsp, cfg, fakeCounter);
+    memcpy(fixedOut, input, sizeof(input));
+    for (int c = 0; c < CHUNKS; c++)
+        stage(dsp, fixedOut + c * CHUNK, CHUNK);
+}
+
+// ========== REFERENCIAS EN DOUBLE ==========
+static void refHighPass(const DspConfig &cfg)
+{
+    double a = cfg.hpfCoeffQ15 / 32768.0;
+    double px = 0, py = 0;
+    for (int i = 0; i < CHUNK * CHUNKS; i++)
+    {
+        double x = input[i];
+        double y = x - px + a * py;
+        px = x;
+        py = y;
+        refOut[i] = y;
+    }
+}
+
+static void refNoiseGate(const DspConfig &cfg)
+{
+    double env = 0, g = cfg.gateFloorQ15 / 32768.0;
+    double ramp = cfg.gateRampQ15 / 32768.0;
+    uint32_t hold = 0;
+    for (int i = 0; i < CHUNK * CHUNKS; i++)
+    {
+        double mag = fabs((double)input[i]);
+        env = mag > env ? mag : env - env / (1 << cfg.gateReleaseShift);
+        if (env >= cfg.gateThreshold)
+            hold = cfg.gateHoldSamples;
+        else if (hold > 0)
+            hold--;
+
+        double target = hold > 0 ? 1.0 : cfg.gateFloorQ15 / 32768.0;
+        if (g < target)
+            g = fmin(g + ramp, target);
+        else if (g > target)
+            g = fmax(g - ramp, target);
+        refOut[i] = input[i] * g;
+    }
+}
+
+static void refAgcLimiter(const DspConfig &cfg)
+{
+    double gain = 1.0, lg = 1.0;
+    double ceiling = cfg.limiterCeiling;
+    for (int c = 0; c < CHUNKS; c++)
+    {
+        const int32_t *in = input + c * CHUNK;
+        double peak = 0;
+        for (int i = 0; i < CHUNK; i++)
+            peak = fmax(peak, fabs((double)in[i]));
+
+        double from = gain, to = gain;
+        if (peak >= cfg.gateThreshold)
+        {
+            double desired = fmin(fmax(cfg.agcTarget / peak, cfg.agcMinGainQ8 / 256.0), cfg.agcMaxGainQ8 / 256.0);
+            to = desired < from ? desired : from + (desired - from) / (1 << cfg.agcReleaseShift);
+        }
+
+        for (int i = 0; i < CHUNK; i++)
+        {
+            double s = in[i] * (from + (to - from) * i / CHUNK);
+            double v = s * lg;
+            if (fabs(v) > ceiling)
+            {
+                lg = ceiling / fabs(s);
+                v = v < 0 ? -ceiling : ceiling;
+            }
+            else
+            {
+                lg += (1.0 - lg) / (1 << cfg.limiterReleaseShift);
+            }
+            refOut[c * CHUNK + i] = v;
+        }
+        gain = to;
+    }
+}
+
+// ========== HPF ==========
+static void checkHighPass(uint8_t levelShift, double bound)
+{
+    DspConfig cfg = dspDefaultConfig(0, RATE, COEFF_16K, levelShift);
+    makeSpeech(levelShift, 8000, 1500);
+    runStage(cfg, dspHighPass);
+    refHighPass(cfg);
+    TEST_ASSERT_LESS_OR_EQUAL(bound, maxError(0));
+
+    // El DC debe desaparecer: media del último segundo cercana a cero
+    double mean = 0;
+    for (int i = CHUNK * CHUNKS - RATE; i < CHUNK * CHUNKS; i++)
+        mean += fixedOut[i];
+    mean /= RATE;
+    TEST_ASSERT_LESS_OR_EQUAL(20.0 * (1 << levelShift), fabs(mean));
+}
+
+void test_hpf_16bit_matches_reference()
+{
+    checkHighPass(0, 3.0); // hpfFracBits = 8
+}
+
+void test_hpf_24bit_matches_reference()
+{
+    // hpfFracBits = 4: cota de 24 LSB de 24 bits (< 0.1 LSB de 16 bits)
+    TEST_ASSERT_EQUAL_UINT8(4, dspDefaultConfig(0, RATE, COEFF_16K, 8).hpfFracBits);
+    checkHighPass(8, 24.0);
+}
+
+void test_hpf_24bit_full_scale_does_not_overflow()
+{
+    // Tras micShift de 24 bits la entrada llega a ±2^25 (ganancia x4)
+    DspConfig cfg = dspDefaultConfig(0, RATE, COEFF_16K, 8);
+    for (int i = 0; i < CHUNK * CHUNKS; i++)
+        input[i] = (i / 8) % 2 ? (1 << 25) - 1 : -(1 << 25);
+    runStage(cfg, dspHighPass);
+    refHighPass(cfg);
+    TEST_ASSERT_LESS_OR_EQUAL(24.0, maxError(0));
+}
+
+// ========== GATE ==========
+// Las decisiones de la compuerta (umbral, hold) pueden caer unas muestras
+// antes o después que en la referencia; cada muestra de desfase cambia la
+// ganancia en un paso de rampa. Cota: 8 pasos de rampa sobre el pico.
+static void checkNoiseGate(uint8_t levelShift)
+{
+    const int32_t amplitude = 8000;
+    DspConfig cfg = dspDefaultConfig(0, RATE, COEFF_16K, levelShift);
+    makeSpeech(levelShift, amplitude, 0);
+    runStage(cfg, dspNoiseGate);
+    refNoiseGate(cfg);
+
+    double rampStep = cfg.gateRampQ15 / 32768.0 * ((double)amplitude * (1 << levelShift));
+    TEST_ASSERT_LESS_OR_EQUAL(8 * rampStep, maxError(0));
+
+    // Al final del primer silencio la compuerta ya atenúa -24 dB
+    double peak = 0;
+    for (int i = RATE * 3 / 2 - RATE / 8; i < RATE * 3 / 2; i++)
+        peak = fmax(peak, fabs((double)fixedOut[i]));
+    TEST_ASSERT_LESS_OR_EQUAL(60.0 * (1 << levelShift) * cfg.gateFloorQ15 / 32768.0 + 1, peak);
+}
+
+void test_gate_16bit_matches_reference()
+{
+    checkNoiseGate(0);
+}
+
+void test_gate_24bit_matches_reference()
+{
+    checkNoiseGate(8);
+}
+
+// ========== AGC + LIMITADOR ==========
+static void checkAgcLimiter(uint8_t levelShift, int32_t amplitude)
+{
+    DspConfig cfg = dspDefaultConfig(0, RATE, COEFF_16K, levelShift);
+    makeSpeech(levelShift, amplitude, 0);
+    runStage(cfg, dspAgcLimiter);
+    refAgcLimiter(cfg);
+
+    // Ganancia en Q8 (resolución 0.4% por debajo de x1) e interpolación
+    // en Q16: 1% del techo del limitador
+    TEST_ASSERT_LESS_OR_EQUAL(cfg.limiterCeiling * 0.01, maxError(0));
+
+    for (int i = 0; i < CHUNK * CHUNKS; i++)
+    {
+        int32_t mag = fixedOut[i] < 0 ? -fixedOut[i] : fixedOut[i];
+        TEST_ASSERT_LESS_OR_EQUAL(cfg.limiterCeiling, mag);
+    }
+
+    // Tras varias ráfagas de voz la ganancia converge a objetivo / pico
+    double inPeak = 0;
+    for (int i = 0; i < RATE / 2; i++)
+        inPeak = fmax(inPeak, fabs((double)input[i]));
+    double expected = fmin(fmax(cfg.agcTarget / inPeak, cfg.agcMinGainQ8 / 256.0), cfg.agcMaxGainQ8 / 256.0);
+    TEST_ASSERT_DOUBLE_WITHIN(expected * 0.1, expected, dsp.agcGainQ8 / 256.0);
+}
+
+void test_agc_16bit_quiet_voice_matches_reference()
+{
+    checkAgcLimiter(0, 3000); // Sube la ganancia (~x5)
+}
+
+void test_agc_16bit_loud_voice_matches_reference()
+{
+    checkAgcLimiter(0, 30000); // Baja la ganancia y actúa el limitador
+}
+
+void test_agc_24bit_matches_reference()
+{
+    checkAgcLimiter(8, 3000);
+}
+
+// ========== PRESUPUESTO ==========
+static void processChunks(int count)
+{
+    static int32_t buf[CHUNK];
+    for (int c = 0; c < count; c++)
+    {
+        memcpy(buf, input, sizeof(buf));
+        dspProcessChunk(dsp, buf, CHUNK);
+    }
+}
+
+void test_budget_drops_stages_by_priority()
+{
+    makeSpeech(0, 8000, 0);
+    DspConfig cfg = dspDefaultConfig(2500, RATE, COEFF_16K, 0);
+    dspInit(dsp, cfg, fakeCounter);
+
+    // 1000 ciclos por etapa: 3000 > 2500 → se quita el AGC
+    fakeStageCost = 1000;
+    processChunks(1);
+    TEST_ASSERT_EQUAL_HEX8(DSP_STAGE_HPF | DSP_STAGE_GATE, dsp.active);
+    TEST_ASSERT_EQUAL_UINT32(3000, dsp.lastCycles);
+
+    // 2000 ≤ 2500: se mantiene, y el AGC no cabe en el 80% (2000)
+    processChunks(DSP_RECOVER_CHUNKS * 2);
+    TEST_ASSERT_EQUAL_HEX8(DSP_STAGE_HPF | DSP_STAGE_GATE, dsp.active);
+
+    // Con un presupuesto menor cae también la compuerta y después el HPF
+    dsp.cfg.budgetCycles = 1500;
+    processChunks(1);
+    TEST_ASSERT_EQUAL_HEX8(DSP_STAGE_HPF, dsp.active);
+    dsp.cfg.budgetCycles = 500;
+    processChunks(1);
+    TEST_ASSERT_EQUAL_HEX8(0, dsp.active);
+}
+
+void test_budget_recovers_after_slack_chunks()
+{
+    makeSpeech(0, 8000, 0);
+    DspConfig cfg = dspDefaultConfig(2500, RATE, COEFF_16K, 0);
+    dspInit(dsp, cfg, fakeCounter);
+
+    fakeStageCost = 1000;
+    processChunks(1);
+    TEST_ASSERT_EQUAL_HEX8(DSP_STAGE_HPF | DSP_STAGE_GATE, dsp.active);
+
+    // HPF + Gate a 400: estimación con el AGC = 400 + 400 + 1000 (último
+    // coste conocido) = 1800 < 2000 → vuelve tras DSP_RECOVER_CHUNKS
+    fakeStageCost = 400;
+    processChunks(DSP_RECOVER_CHUNKS - 1);
+    TEST_ASSERT_EQUAL_HEX8(DSP_STAGE_HPF | DSP_STAGE_GATE, dsp.active);
+    processChunks(1);
+    TEST_ASSERT_EQUAL_HEX8(DSP_STAGE_HPF | DSP_STAGE_GATE | DSP_STAGE_AGC, dsp.active);
+    TEST_ASSERT_EQUAL_UINT32(0, dsp.slackChunks);
+}
+
+void test_budget_zero_disables_control()
+{
+    DspConfig cfg = dspDefaultConfig(0, RATE, COEFF_16K, 0);
+    dspInit(dsp, cfg, fakeCounter);
+    fakeStageCost = 1000000;
+    processChunks(4);
+    TEST_ASSERT_EQUAL_HEX8(cfg.stages, dsp.active);
+}
+
+void setUp()
+{
+    fakeCycles = 0;
+    fakeStageCost = 0;
+}
+
+void tearDown() {}
+
+int runTests()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_hpf_16bit_matches_reference);
+    RUN_TEST(test_hpf_24bit_matches_reference);
+    RUN_TEST(test_hpf_24bit_full_scale_does_not_overflow);
+    RUN_TEST(test_gate_16bit_matches_reference);
+    RUN_TEST(test_gate_24bit_matches_reference);
+    RUN_TEST(test_agc_16bit_quiet_voice_matches_reference);
+    RUN_TEST(test_agc_16bit_loud_voice_matches_reference);
+    RUN_TEST(test_agc_24bit_matches_reference);
+    RUN_TEST(test_budget_drops_stages_by_priority);
+    RUN_TEST(test_budget_recovers_after_slack_chunks);
+    RUN_TEST(test_budget_zero_disables_control);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+void setup()
+{
+    delay(2000);
+    runTests();
+}
+void loop() {}
+#else
+int main()
+{
+    return runTests();
+}
+#endif
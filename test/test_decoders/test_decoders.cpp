@@ -0,0 +1,227 @@
+/* Decodificadores de respuestas (src/audio_codec.h)
+
+   Corrección: vectores de referencia de µ-law (G.711) y bloques IMA ADPCM
+   mono y estéreo cortos cuyo PCM se calculó con el algoritmo de referencia
+   de IMA (el mismo que usa tools/make_earcons.py para codificar).
+
+   Rendimiento: decodifica 10 s de audio sintético en cada formato y exige
+   un factor de tiempo real mínimo. La reproducción comparte el núcleo con la lectura de
+   la SD, el mezclado de prompts y la escritura I2S, así que el decodificador
+   no debe pasar de ~5% de la CPU: MIN_REALTIME_FACTOR = 20.
+
+   Sustituye a la medida que B hacía en cada arranque: ahora falla si un
+   cambio hace el decodificador más lento, en lugar de solo imprimirlo.
+
+   ESP32:  pio test -e processor   (las cotas de rendimiento son para esta)
+   Host:   pio test -e native      (corrección; el host supera las cotas)
+*/
+
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../../src/audio_codec.h"
+
+#ifndef MIN_REALTIME_FACTOR
+#define MIN_REALTIME_FACTOR 20
+#endif
+
+#define RATE 16000   // Perfil de audio más exigente (AUDIO_SAMPLE_RATE)
+#define SECONDS 10
+#define MAX_BLOCK 1024
+
+#ifdef ARDUINO
+#include <Arduino.h>
+static uint32_t nowUs() { return micros(); }
+#else
+#include <chrono>
+static uint32_t nowUs()
+{
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+static uint8_t block[MAX_BLOCK];
+static int16_t pcm[MAX_BLOCK * 2 + 2];
+
+// Bytes pseudoaleatorios: cualquier secuencia de nibbles es ADPCM válido
+static void fillBlock(int size)
+{
+    uint32_t seed = 12345;
+    for (int i = 0; i < size; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        block[i] = seed >> 24;
+    }
+}
+
+// ========== CORRECCIÓN ==========
+void test_mulaw_golden_values()
+{
+    // Extremos y ceros de la tabla G.711 (bit de signo a 1 = positivo)
+    TEST_ASSERT_EQUAL_INT(-32124, mulawDecode(0x00));
+    TEST_ASSERT_EQUAL_INT(32124, mulawDecode(0x80));
+    TEST_ASSERT_EQUAL_INT(0, mulawDecode(0xFF));
+    TEST_ASSERT_EQUAL_INT(0, mulawDecode(0x7F));
+    TEST_ASSERT_EQUAL_INT(8, mulawDecode(0xFE));
+    TEST_ASSERT_EQUAL_INT(-8, mulawDecode(0x7E));
+    TEST_ASSERT_EQUAL_INT(132, mulawDecode(0xEF));
+    TEST_ASSERT_EQUAL_INT(-132, mulawDecode(0x6F));
+
+    const uint8_t in[] = {0x00, 0x80, 0xFF, 0xEF};
+    const int16_t expected[] = {-32124, 32124, 0, 132};
+    int16_t out[4];
+    decodeMulaw(in, 4, out);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(expected, out, 4);
+}
+
+// Cabecera de canal: predictor 1000, índice 20
+#define IMA_HEADER_A 0xE8, 0x03, 20, 0
+// Cabecera de canal: predictor -200, índice 60
+#define IMA_HEADER_B 0x38, 0xFF, 60, 0
+#define IMA_DATA_A 0x77, 0x77, 0xFF, 0x1F
+#define IMA_DATA_B 0x34, 0x12, 0xA9, 0x0C
+
+static const int16_t IMA_PCM_A[9] = {1000, 1093, 1292, 1722, 2647, 660, -3600, -12731, -8816};
+static const int16_t IMA_PCM_B[9] = {-200, 2356, 4760, 6321, 7173, 6399, 5226, 3306, 3564};
+
+void test_adpcm_mono_golden_block()
+{
+    const uint8_t in[] = {IMA_HEADER_A, IMA_DATA_A};
+    TEST_ASSERT_EQUAL_INT(9, imaSamplesPerBlock(sizeof(in), 1));
+    TEST_ASSERT_EQUAL_INT(9, decodeImaAdpcmBlock(in, sizeof(in), 1, pcm));
+    TEST_ASSERT_EQUAL_INT16_ARRAY(IMA_PCM_A, pcm, 9);
+}
+
+void test_adpcm_stereo_golden_block()
+{
+    // Cabeceras L y R, después grupos de 4 bytes alternando canales
+    const uint8_t in[] = {IMA_HEADER_A, IMA_HEADER_B, IMA_DATA_A, IMA_DATA_B};
+    TEST_ASSERT_EQUAL_INT(9, imaSamplesPerBlock(sizeof(in), 2));
+    TEST_ASSERT_EQUAL_INT(9, decodeImaAdpcmBlock(in, sizeof(in), 2, pcm));
+    for (int i = 0; i < 9; i++)
+    {
+        TEST_ASSERT_EQUAL_INT(IMA_PCM_A[i], pcm[i * 2]);
+        TEST_ASSERT_EQUAL_INT(IMA_PCM_B[i], pcm[i * 2 + 1]);
+    }
+}
+
+void test_adpcm_clips_at_full_scale()
+{
+    // Predictor 32000, índice 88: los pasos positivos saturan en 32767
+    const uint8_t in[] = {0x00, 0x7D, 88, 0, 0x77, 0x00, 0x88, 0x08};
+    const int16_t expected[] = {32000, 32767, 32767, 32767, 32767, 29382, 26305, 23507, 26050};
+    TEST_ASSERT_EQUAL_INT(9, decodeImaAdpcmBlock(in, sizeof(in), 1, pcm));
+    TEST_ASSERT_EQUAL_INT16_ARRAY(expected, pcm, 9);
+}
+
+void test_adpcm_rejects_invalid_blocks()
+{
+    const uint8_t in[8] = {IMA_HEADER_A, IMA_DATA_A};
+    TEST_ASSERT_EQUAL_INT(0, decodeImaAdpcmBlock(in, 3, 1, pcm));
+    TEST_ASSERT_EQUAL_INT(0, decodeImaAdpcmBlock(in, 7, 2, pcm));
+    TEST_ASSERT_EQUAL_INT(0, decodeImaAdpcmBlock(in, sizeof(in), 3, pcm));
+}
+
+// ========== RENDIMIENTO ==========
+static void reportAndCheck(const char *name, uint32_t us)
+{
+    uint32_t factor = (uint32_t)(SECONDS * 1000000ULL / (us ? us : 1));
+    char msg[96];
+    snprintf(msg, sizeof(msg), "%s: %lu us por %d s de audio (%lux tiempo real)",
+             name, (unsigned long)us, SECONDS, (unsigned long)factor);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32_MESSAGE(MIN_REALTIME_FACTOR, factor, msg);
+}
+
+static void benchmarkAdpcm(const char *name, int blockAlign, int channels)
+{
+    fillBlock(blockAlign);
+    int frames = imaSamplesPerBlock(blockAlign, channels);
+    TEST_ASSERT_EQUAL_INT(frames, decodeImaAdpcmBlock(block, blockAlign, channels, pcm));
+
+    uint32_t total = 0;
+    uint32_t t0 = nowUs();
+    while (total < RATE * SECONDS)
+    {
+        total += decodeImaAdpcmBlock(block, blockAlign, channels, pcm);
+    }
+    reportAndCheck(name, nowUs() - t0);
+}
+
+void test_adpcm_mono_256()
+{
+    benchmarkAdpcm("IMA ADPCM mono, bloque 256", 256, 1);
+}
+
+void test_adpcm_mono_1024()
+{
+    benchmarkAdpcm("IMA ADPCM mono, bloque 1024", 1024, 1);
+}
+
+void test_adpcm_stereo_512()
+{
+    benchmarkAdpcm("IMA ADPCM estéreo, bloque 512", 512, 2);
+}
+
+void test_adpcm_stereo_1024()
+{
+    benchmarkAdpcm("IMA ADPCM estéreo, bloque 1024", 1024, 2);
+}
+
+static void benchmarkMulaw(const char *name, int channels)
+{
+    fillBlock(MAX_BLOCK);
+    uint32_t total = 0;
+    uint32_t t0 = nowUs();
+    while (total < RATE * SECONDS)
+    {
+        decodeMulaw(block, MAX_BLOCK, pcm);
+        total += MAX_BLOCK / channels;
+    }
+    reportAndCheck(name, nowUs() - t0);
+}
+
+void test_mulaw_mono()
+{
+    benchmarkMulaw("µ-law mono", 1);
+}
+
+void test_mulaw_stereo()
+{
+    benchmarkMulaw("µ-law estéreo", 2);
+}
+
+void setUp() {}
+void tearDown() {}
+
+int runTests()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_mulaw_golden_values);
+    RUN_TEST(test_adpcm_mono_golden_block);
+    RUN_TEST(test_adpcm_stereo_golden_block);
+    RUN_TEST(test_adpcm_clips_at_full_scale);
+    RUN_TEST(test_adpcm_rejects_invalid_blocks);
+    RUN_TEST(test_adpcm_mono_256);
+    RUN_TEST(test_adpcm_mono_1024);
+    RUN_TEST(test_adpcm_stereo_512);
+    RUN_TEST(test_adpcm_stereo_1024);
+    RUN_TEST(test_mulaw_mono);
+    RUN_TEST(test_mulaw_stereo);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup()
+{
+    delay(2000);
+    runTests();
+}
+void loop() {}
+#else
+int main()
+{
+    return runTests();
+}
+#endif
@@ -0,0 +1,179 @@
+/* Pruebas del núcleo del enlace (src/link_core.h) con LoopbackTransport
+
+   Se envía una grabación completa como la de A (START, chunks de audio,
+   STOP) y se lee como B, en bloques de 256 bytes. Se comprueba que los
+   bytes llegan intactos y en orden y que las estadísticas comunes a todos
+   los backends (TX, RX, pérdidas, llamadas a send) cuadran.
+
+   Host:   pio test -e native
+*/
+
+#include <unity.h>
+#include <thread>
+#include "../../src/link_core.h"
+
+#define CHUNK_BYTES 4096 // Chunk de 128 ms a 16 kHz / 16 bits
+#define CHUNKS 12
+#define READ_BYTES 256   // Lectura de B por pasada
+#define RING_BYTES 24576 // LINK_RX_BUFFER de B
+
+static const char START[] = "START 16000/16\n";
+static const char STOP[] = "STOP\n";
+
+static uint8_t chunk[CHUNK_BYTES];
+static uint8_t received[CHUNK_BYTES * CHUNKS + 64];
+
+static void fillChunk(int index)
+{
+    for (int i = 0; i < CHUNK_BYTES; i++)
+        chunk[i] = (uint8_t)(index * 31 + i * 7);
+}
+
+// Lee todo lo pendiente como lo hace B
+static size_t drain(LinkTransport &link, uint8_t *out, size_t max)
+{
+    size_t total = 0;
+    uint8_t buf[READ_BYTES];
+    int n;
+    while ((n = link.receive(buf, sizeof(buf), 0)) > 0)
+    {
+        if (total + n <= max)
+            memcpy(out + total, buf, n);
+        total += n;
+    }
+    return total;
+}
+
+void test_recording_roundtrip()
+{
+    LoopbackTransport link(RING_BYTES);
+    TEST_ASSERT_TRUE(link.begin());
+
+    // START
+    TEST_ASSERT_EQUAL_INT(strlen(START), link.send((const uint8_t *)START, strlen(START)));
+    uint8_t cmd[32];
+    size_t n = drain(link, cmd, sizeof(cmd));
+    TEST_ASSERT_EQUAL(strlen(START), n);
+    TEST_ASSERT_EQUAL_MEMORY(START, cmd, n);
+
+    // Audio: B lee cada chunk antes de que llegue el siguiente
+    size_t audio = 0;
+    for (int c = 0; c < CHUNKS; c++)
+    {
+        fillChunk(c);
+        TEST_ASSERT_EQUAL_INT(CHUNK_BYTES, link.send(chunk, CHUNK_BYTES));
+        link.flush();
+        audio += drain(link, received + audio, sizeof(received) - audio);
+    }
+    TEST_ASSERT_EQUAL(CHUNK_BYTES * CHUNKS, audio);
+    for (int c = 0; c < CHUNKS; c++)
+    {
+        fillChunk(c);
+        TEST_ASSERT_EQUAL_MEMORY(chunk, received + c * CHUNK_BYTES, CHUNK_BYTES);
+    }
+
+    // STOP
+    link.send((const uint8_t *)STOP, strlen(STOP));
+    n = drain(link, cmd, sizeof(cmd));
+    TEST_ASSERT_EQUAL(strlen(STOP), n);
+    TEST_ASSERT_EQUAL_MEMORY(STOP, cmd, n);
+
+    LinkStats s = link.readStats();
+    uint32_t total = strlen(START) + CHUNK_BYTES * CHUNKS + strlen(STOP);
+    TEST_ASSERT_EQUAL_UINT32(total, s.bytesTx);
+    TEST_ASSERT_EQUAL_UINT32(total, s.bytesRx);
+    TEST_ASSERT_EQUAL_UINT32(0, s.bytesLost);
+    TEST_ASSERT_EQUAL_UINT32(CHUNKS + 2, s.sendCalls);
+    TEST_ASSERT_TRUE(s.latencyUsMax * s.sendCalls >= s.latencyUsTotal);
+
+    char line[192];
+    link.formatStats(line, sizeof(line));
+    TEST_ASSERT_TRUE(strstr(line, "Loopback") != NULL);
+}
+
+void test_overflow_counts_lost_bytes()
+{
+    // B no lee a tiempo: lo que no cabe se cuenta como pérdida
+    LoopbackTransport link(CHUNK_BYTES * 2);
+    TEST_ASSERT_TRUE(link.begin());
+
+    for (int c = 0; c < 3; c++)
+    {
+        fillChunk(c);
+        link.send(chunk, CHUNK_BYTES);
+    }
+
+    LinkStats s = link.readStats();
+    TEST_ASSERT_EQUAL_UINT32(CHUNK_BYTES * 2, s.bytesTx);
+    TEST_ASSERT_EQUAL_UINT32(CHUNK_BYTES, s.bytesLost);
+
+    // Lo que sí entró llega intacto
+    size_t n = drain(link, received, sizeof(received));
+    TEST_ASSERT_EQUAL(CHUNK_BYTES * 2, n);
+    fillChunk(1);
+    TEST_ASSERT_EQUAL_MEMORY(chunk, received + CHUNK_BYTES, CHUNK_BYTES);
+}
+
+void test_reset_stats()
+{
+    LoopbackTransport link(1024);
+    TEST_ASSERT_TRUE(link.begin());
+    link.send((const uint8_t *)START, strlen(START));
+    link.resetStats();
+
+    LinkStats s = link.readStats();
+    TEST_ASSERT_EQUAL_UINT32(0, s.bytesTx);
+    TEST_ASSERT_EQUAL_UINT32(0, s.sendCalls);
+
+    // El reinicio no vacía el buffer, solo la contabilidad
+    uint8_t cmd[32];
+    TEST_ASSERT_EQUAL(strlen(START), drain(link, cmd, sizeof(cmd)));
+    TEST_ASSERT_EQUAL_UINT32(strlen(START), link.readStats().bytesRx);
+}
+
+// Simula el callback de ESP-NOW, que cuenta pérdidas desde otra tarea
+class CallbackLoopback : public LoopbackTransport
+{
+public:
+    explicit CallbackLoopback(size_t capacity) : LoopbackTransport(capacity) {}
+    void lostFromCallback(uint32_t bytes) { countLost(bytes); }
+};
+
+void test_stats_are_consistent_across_tasks()
+{
+    const int rounds = 20000;
+    CallbackLoopback link(64);
+    TEST_ASSERT_TRUE(link.begin());
+
+    std::thread callback([&]() {
+        for (int i = 0; i < rounds; i++)
+            link.lostFromCallback(1);
+    });
+
+    uint8_t byte = 0x55, out;
+    for (int i = 0; i < rounds; i++)
+    {
+        link.send(&byte, 1);
+        link.receive(&out, 1, 0);
+    }
+    callback.join();
+
+    LinkStats s = link.readStats();
+    TEST_ASSERT_EQUAL_UINT32(rounds, s.bytesTx);
+    TEST_ASSERT_EQUAL_UINT32(rounds, s.bytesRx);
+    TEST_ASSERT_EQUAL_UINT32(rounds, s.bytesLost);
+    TEST_ASSERT_EQUAL_UINT32(rounds, s.sendCalls);
+}
+
+void setUp() {}
+void tearDown() {}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_recording_roundtrip);
+    RUN_TEST(test_overflow_counts_lost_bytes);
+    RUN_TEST(test_reset_stats);
+    RUN_TEST(test_stats_are_consistent_across_tasks);
+    return UNITY_END();
+}
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""Genera los earcons de ESP32 B en data/earcons/ como WAV IMA ADPCM.
+
+  python tools/make_earcons.py                     # earcons sintéticos a 16 kHz
+  python tools/make_earcons.py --rate 8000         # para los entornos *_8k
+  python tools/make_earcons.py --prompt hmm.wav    # añade prompts grabados
+
+Los --prompt deben ser WAV PCM 16 bits mono a la misma frecuencia; se
+guardan como thinking<N>.wav. Después: pio run -e processor -t uploadfs
+"""
+
+import argparse
+import math
+import os
+import struct
+import wave
+
+STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31,
+    34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143,
+    157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+    724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024,
+    3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767]
+INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8]
+
+BLOCK_ALIGN = 256
+SAMPLES_PER_BLOCK = (BLOCK_ALIGN - 4) * 2 + 1
+
+
+def ima_encode_block(samples, state):
+    """Codifica hasta SAMPLES_PER_BLOCK muestras mono en un bloque IMA de WAV."""
+    predictor, index = samples[0], state[1]
+    block = bytearray(struct.pack("<hBB", predictor, index, 0))
+    nibbles = []
+
+    for s in samples[1:]:
+        step = STEP_TABLE[index]
+        diff = s - predictor
+        nibble = 0
+        if diff < 0:
+            nibble = 8
+            diff = -diff
+        delta = step >> 3
+        if diff >= step:
+            nibble |= 4
+            diff -= step
+            delta += step
+        if diff >= step >> 1:
+            nibble |= 2
+            diff -= step >> 1
+            delta += step >> 1
+        if diff >= step >> 2:
+            nibble |= 1
+            delta += step >> 2
+
+        predictor += -delta if nibble & 8 else delta
+        predictor = max(-32768, min(32767, predictor))
+        index = max(0, min(88, index + INDEX_TABLE[nibble]))
+        nibbles.append(nibble)
+
+    if len(nibbles) % 8:
+        nibbles += [0] * (8 - len(nibbles) % 8)
+    for i in range(0, len(nibbles), 2):
+        block.append(nibbles[i] | (nibbles[i + 1] << 4))
+
+    state[1] = index
+    return bytes(block)
+
+
+def write_ima_wav(path, samples, rate):
+    state = [0, 0]
+    data = bytearray()
+    for i in range(0, len(samples), SAMPLES_PER_BLOCK):
+        data += ima_encode_block(samples[i:i + SAMPLES_PER_BLOCK], state)
+
+    fmt = struct.pack("<HHIIHHHH", 0x11, 1, rate, rate * BLOCK_ALIGN // SAMPLES_PER_BLOCK,
+                      BLOCK_ALIGN, 4, 2, SAMPLES_PER_BLOCK)
+    fact = struct.pack("<I", len(samples))
+    riff = (b"WAVE" + b"fmt " + struct.pack("<I", len(fmt)) + fmt +
+            b"fact" + struct.pack("<I", len(fact)) + fact +
+            b"data" + struct.pack("<I", len(data)) + bytes(data))
+
+    with open(path, "wb") as f:
+        f.write(b"RIFF" + struct.pack("<I", len(riff)) + riff)
+    print(f"{path}: {len(samples) / rate:.2f} s, {len(riff) + 8} bytes")
+
+
+def tone(rate, notes, level=6000):
+    """Notas (frecuencia, duración) con ataque corto y caída exponencial."""
+    out = []
+    for freq, dur in notes:
+        n = int(rate * dur)
+        for i in range(n):
+            t = i / rate
+            env = min(1.0, i / (0.005 * rate)) * math.exp(-5.0 * t / dur)
+            v = 0.0 if freq == 0 else math.sin(2 * math.pi * freq * t) + 0.3 * math.sin(4 * math.pi * freq * t)
+            out.append(int(level * env * v / 1.3))
+    return out
+
+
+def read_prompt(path, rate):
+    with wave.open(path, "rb") as w:
+        if w.getsampwidth() != 2 or w.getnchannels() != 1 or w.getframerate() != rate:
+            raise SystemExit(f"{path}: se necesita PCM 16 bits mono a {rate} Hz")
+        raw = w.readframes(w.getnframes())
+    return list(struct.unpack(f"<{len(raw) // 2}h", raw))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--rate", type=int, default=16000)
+    parser.add_argument("--out", default=os.path.join(os.path.dirname(__file__), "..", "data", "earcons"))
+    parser.add_argument("--prompt", action="append", default=[])
+    args = parser.parse_args()
+
+    os.makedirs(args.out, exist_ok=True)
+
+    # Confirmación al soltar el botón: dos notas ascendentes
+    write_ima_wav(os.path.join(args.out, "ack.wav"),
+                  tone(args.rate, [(880, 0.09), (1320, 0.14)]), args.rate)
+
+    # Espera: pulso suave de dos notas graves
+    write_ima_wav(os.path.join(args.out, "thinking1.wav"),
+                  tone(args.rate, [(523, 0.18), (0, 0.12), (659, 0.25)], level=3500), args.rate)
+
+    for i, path in enumerate(args.prompt, 2):
+        write_ima_wav(os.path.join(args.out, f"thinking{i}.wav"), read_prompt(path, args.rate), args.rate)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,390 @@
+#!/usr/bin/env python3
+"""Herramienta de host para las trazas de ESP32 B (/trace.bin, ver src/trace.h).
+
+Comandos:
+  summary TRACE
+      Resumen por turno: bytes del enlace, subida, backend, respuesta y
+      reproducción.
+
+  link TRACE --port /dev/ttyUSB0 [--node 1] [--baud 921600] [--speed recorded|max]
+      Reenvía los bytes del enlace grabados (START, audio, STOP) de un nodo
+      de captura por un puerto serie conectado al RX de ese nodo en un
+      ESP32 B. B los procesa como si vinieran del ESP32 A: recepción,
+      subida y reproducción reales. Requiere pyserial.
+
+  serve TRACE [--host 0.0.0.0] [--http-port 8000] [--speed recorded|max]
+      Backend simulado para POST /audio. Reproduce los errores y latencias
+      grabados según la posición en bytes de cada chunk (no su número, que
+      cambia con el tamaño de chunk adaptativo) y responde al chunk con
+      X-Last-Chunk: true con la respuesta grabada. Configura B con la IP
+      de este equipo como api_host.
+
+Con `link` y `serve` a la vez se reproduce un problema de campo completo y
+de forma repetible: mismo audio, mismos errores HTTP, mismas latencias.
+Con --speed max se eliminan las esperas para usarlo como benchmark.
+"""
+
+import argparse
+import collections
+import http.server
+import re
+import struct
+import sys
+import threading
+import time
+
+TRACE_LINK_RX = 1
+TRACE_UPLOAD = 2
+TRACE_RESPONSE = 3
+TRACE_PLAYBACK = 4
+
+PLAY_EVENTS = {1: "inicio", 2: "fin", 3: "omitido"}
+
+Record = collections.namedtuple("Record", "type t_ms data node")
+Upload = collections.namedtuple("Upload", "t_ms turn chunk offset size code ms")
+
+
+def read_trace(path):
+    with open(path, "rb") as f:
+        blob = f.read()
+
+    if len(blob) < 10 or blob[:4] != b"MZTR":
+        sys.exit(f"{path}: no es una traza de Mr. Zorro")
+
+    version = blob[4]
+    sample_rate = struct.unpack_from("<I", blob, 5)[0]
+    bits = blob[9]
+    if version not in (1, 2):
+        sys.exit(f"{path}: versión de traza {version} no soportada")
+
+    records = []
+    pos = 10
+    while pos + 7 <= len(blob):
+        rtype, t_ms, length = struct.unpack_from("<BIH", blob, pos)
+        pos += 7
+        if pos + length > len(blob):
+            break  # Registro truncado (corte de energía)
+        data = blob[pos:pos + length]
+        node = 0
+        # Desde v2 los bytes del enlace llevan delante el nodo de captura
+        if rtype == TRACE_LINK_RX and version >= 2 and data:
+            node, data = data[0], data[1:]
+        records.append(Record(rtype, t_ms, data, node))
+        pos += length
+
+    return {"sample_rate": sample_rate, "bits": bits}, records
+
+
+def parse_upload(rec):
+    turn, chunk, offset, size, code, ms = struct.unpack_from("<IIIHhI", rec.data)
+    return Upload(rec.t_ms, turn, chunk, offset, size, code, ms)
+
+
+def collect_turns(records):
+    """Agrupa subidas, respuestas y reproducción por ID de turno."""
+    turns = collections.OrderedDict()
+
+    def turn(tid):
+        return turns.setdefault(tid, {"uploads": [], "response": bytearray(), "play": []})
+
+    for rec in records:
+        if rec.type == TRACE_UPLOAD:
+            up = parse_upload(rec)
+            turn(up.turn)["uploads"].append(up)
+        elif rec.type == TRACE_RESPONSE:
+            tid = struct.unpack_from("<I", rec.data)[0]
+            turn(tid)["response"] += rec.data[4:]
+        elif rec.type == TRACE_PLAYBACK:
+            tid, event = struct.unpack_from("<IB", rec.data)
+            turn(tid)["play"].append((rec.t_ms, event))
+    return turns
+
+
+LINK_CMD_MAX_LEN = len(b"START 24000/24\n")  # audio_config.h
+RECORD_IDLE_TIMEOUT_MS = 3000                 # esp32_B.h
+
+
+def link_sessions(records, header=None):
+    """Divide los bytes del enlace en grabaciones de cada nodo con las mismas
+    reglas que B (parseLinkBytes en esp32_B.h): los comandos se buscan en los
+    bytes crudos, lo que va delante de un comando es audio, los últimos
+    LINK_CMD_MAX_LEN - 1 bytes se retienen por si empiezan un comando partido,
+    un START sin STOP previo cierra la grabación anterior y una grabación sin
+    datos durante RECORD_IDLE_TIMEOUT_MS se cierra sola."""
+    sessions = []
+    nodes = collections.defaultdict(lambda: {"tail": b"", "current": None, "last_rx": 0})
+
+    def finish(state, t_ms, reason):
+        session = state["current"]
+        session["bytes"] += len(state["tail"])
+        state["tail"] = b""
+        session["end"] = t_ms
+        session["reason"] = reason
+        state["current"] = None
+        if session["bytes"]:
+            sessions.append(session)
+
+    def audio(state, n):
+        if state["current"] is not None:
+            state["current"]["bytes"] += n
+
+    for rec in records:
+        if rec.type != TRACE_LINK_RX:
+            continue
+        state = nodes[rec.node]
+        if state["current"] is not None and rec.t_ms - state["last_rx"] >= RECORD_IDLE_TIMEOUT_MS:
+            finish(state, state["last_rx"] + RECORD_IDLE_TIMEOUT_MS, "timeout")
+        if state["current"] is not None:
+            state["current"]["reads"] += 1
+        state["last_rx"] = rec.t_ms
+
+        buf = state["tail"] + bytes(rec.data)
+        state["tail"] = b""
+        pos = 0
+        while pos < len(buf):
+            start = buf.find(b"START", pos)
+            stop = buf.find(b"STOP\n", pos)
+            found = [i for i in (start, stop) if i >= 0]
+            if not found:
+                keep = min(len(buf) - pos, LINK_CMD_MAX_LEN - 1)
+                audio(state, len(buf) - pos - keep)
+                state["tail"] = buf[len(buf) - keep:]
+                break
+
+            at = min(found)
+            audio(state, at - pos)
+            if at == stop:
+                pos = at + len(b"STOP\n")
+                if state["current"] is not None:
+                    finish(state, rec.t_ms, "STOP")
+                continue
+
+            nl = buf.find(b"\n", at, at + LINK_CMD_MAX_LEN)
+            if nl < 0 and len(buf) - at < LINK_CMD_MAX_LEN:
+                state["tail"] = buf[at:]
+                break
+
+            fmt = None
+            if nl >= 0:
+                m = re.match(rb"START (\d+)/(\d+)$", buf[at:nl])
+                fmt = (int(m.group(1)), int(m.group(2))) if m else None
+                pos = nl + 1
+            else:
+                pos = at + len(b"START")
+
+            if state["current"] is not None:
+                finish(state, rec.t_ms, "START")
+            if fmt and header and fmt != (header["sample_rate"], header["bits"]):
+                continue  # B rechaza un formato distinto al suyo
+            state["current"] = {"node": rec.node, "start": rec.t_ms, "end": rec.t_ms,
+                                "bytes": 0, "reads": 0, "reason": None}
+
+    for state in nodes.values():
+        if state["current"] is not None:
+            finish(state, state["last_rx"], "fin de la traza")
+    return sorted(sessions, key=lambda s: s["start"])
+
+
+# ========== summary ==========
+def cmd_summary(args):
+    header, records = read_trace(args.trace)
+    duration = records[-1].t_ms / 1000 if records else 0
+    print(f"Traza: {header['sample_rate']} Hz, {header['bits']} bits, "
+          f"{len(records)} registros, {duration:.1f} s")
+
+    bytes_per_s = header["sample_rate"] * header["bits"] // 8
+    print("\nGrabaciones recibidas por el enlace:")
+    for i, s in enumerate(link_sessions(records, header), 1):
+        secs = max(s["end"] - s["start"], 1) / 1000
+        audio = s["bytes"] / bytes_per_s
+        print(f"  #{i} (nodo {s['node'] + 1}): {s['bytes']} bytes ({audio:.2f} s de audio) en {secs:.2f} s, "
+              f"{s['bytes'] / 1024 / secs:.1f} KB/s, {s['reads']} lecturas"
+              + ("" if s["reason"] == "STOP" else f", sin STOP ({s['reason']})"))
+
+    print("\nTurnos:")
+    for tid, t in collect_turns(records).items():
+        ups = t["uploads"]
+        failed = [u for u in ups if u.code != 200]
+        ok = [u for u in ups if u.code == 200]
+        uploaded = max((u.offset + u.size for u in ok), default=0)
+        line = f"  T{tid}: {uploaded} bytes en {len(ok)} chunks OK, {len(failed)} fallidos"
+        if ups:
+            body = [u.ms for u in ok[:-1]] or [0]
+            line += (f", chunk medio {sum(body) / len(body):.0f} ms, máx {max(u.ms for u in ups)} ms")
+            line += f", tamaño {min(u.size for u in ups)}-{max(u.size for u in ups)} bytes"
+            last = ups[-1]
+            if last.code == 200:
+                line += f", último chunk (backend) {last.ms} ms"
+        if t["response"]:
+            line += f", respuesta {len(t['response'])} bytes"
+        for t_ms, event in t["play"]:
+            if ups and event == 1:
+                line += f", reproducción a los {t_ms - ups[0].t_ms} ms del primer chunk"
+        print(line)
+        for u in failed:
+            print(f"      bytes {u.offset}-{u.offset + u.size}: HTTP {u.code} tras {u.ms} ms")
+
+
+# ========== link ==========
+def cmd_link(args):
+    try:
+        import serial
+    except ImportError:
+        sys.exit("Instala pyserial: pip install pyserial")
+
+    _, records = read_trace(args.trace)
+    chunks = [r for r in records if r.type == TRACE_LINK_RX and r.node == args.node - 1]
+    if not chunks:
+        sys.exit(f"La traza no tiene datos del enlace del nodo {args.node}")
+
+    port = serial.Serial(args.port, args.baud)
+    t0 = time.monotonic()
+    base = chunks[0].t_ms
+    sent = 0
+
+    for rec in chunks:
+        if args.speed == "recorded":
+            wait = (rec.t_ms - base) / 1000 - (time.monotonic() - t0)
+            if wait > 0:
+                time.sleep(wait)
+        port.write(rec.data)
+        sent += len(rec.data)
+
+    port.flush()
+    elapsed = time.monotonic() - t0
+    print(f"{sent} bytes en {elapsed:.2f} s ({sent / 1024 / max(elapsed, 1e-3):.1f} KB/s)")
+
+
+# ========== serve ==========
+class ReplayBackend:
+    """Devuelve los resultados grabados. Los IDs de turno de B al reproducir
+    no tienen por qué coincidir con los de la traza, así que el n-ésimo turno
+    nuevo que llega se asocia al n-ésimo turno de la traza.
+
+    Con chunks adaptativos los límites de cada chunk dependen de la
+    estimación del enlace en el momento de reproducir, así que no se usa
+    X-Chunk-Number sino rangos de bytes (X-Chunk-Offset + longitud):
+    - un intento fallido grabado se devuelve una vez al primer chunk que se
+      solape con sus bytes;
+    - los chunks que suben bien tardan lo grabado, en proporción a su tamaño;
+    - el chunk con X-Last-Chunk: true recibe la latencia del backend y la
+      respuesta grabadas."""
+
+    def __init__(self, records, speed):
+        self.turns = list(collect_turns(records).items())
+        self.speed = speed
+        self.mapping = {}
+        self.lock = threading.Lock()
+
+    def _start(self, turn_id):
+        index = len(self.mapping)
+        if index >= len(self.turns):
+            return None
+        _, data = self.turns[index]
+        ups = data["uploads"]
+        ok = [u for u in ups if u.code == 200]
+        state = {
+            "failures": [u for u in ups if u.code != 200],
+            "ok": ok[:-1],
+            "last": ok[-1] if ok and ok[-1] is ups[-1] else None,
+            "response": bytes(data["response"]),
+        }
+        self.mapping[turn_id] = state
+        return state
+
+    def handle(self, turn_id, offset, length, is_last):
+        with self.lock:
+            state = self.mapping.get(turn_id) or self._start(turn_id)
+            if state is None:
+                return 200, 0, b""
+
+            end = offset + length
+            for i, u in enumerate(state["failures"]):
+                if u.offset < end and offset < u.offset + u.size:
+                    del state["failures"][i]
+                    return u.code, self._delay(u.ms), b""
+
+        if is_last:
+            last = state["last"]
+            if last is None:
+                return 500, 0, b""  # El turno grabado nunca terminó
+            return 200, self._delay(last.ms), state["response"]
+
+        # Ritmo grabado (ms por byte) del chunk que contenía este offset
+        for u in state["ok"]:
+            if u.offset <= offset < u.offset + u.size:
+                return 200, self._delay(u.ms * length / max(u.size, 1)), b""
+        return 200, 0, b""
+
+    def _delay(self, ms):
+        return ms / 1000 if self.speed == "recorded" else 0
+
+
+def cmd_serve(args):
+    _, records = read_trace(args.trace)
+    backend = ReplayBackend(records, args.speed)
+
+    class Handler(http.server.BaseHTTPRequestHandler):
+        def do_POST(self):
+            length = int(self.headers.get("Content-Length", 0))
+            self.rfile.read(length)
+            # X-Turn-Id se reinicia en cada arranque de B: la clave es la pareja
+            turn = (self.headers.get("X-Session-Id", ""), int(self.headers.get("X-Turn-Id", 0)))
+            offset = int(self.headers.get("X-Chunk-Offset", 0))
+            is_last = self.headers.get("X-Last-Chunk", "false") == "true"
+
+            code, delay, body = backend.handle(turn, offset, length, is_last)
+            if delay:
+                time.sleep(delay)
+
+            # Los códigos negativos son errores locales de HTTPClient
+            # (timeout, conexión); se simulan cortando la conexión.
+            if code <= 0:
+                self.close_connection = True
+                return
+
+            self.send_response(code)
+            self.send_header("Content-Type", "audio/wav")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+        def log_message(self, fmt, *a):
+            sys.stderr.write("[serve] " + fmt % a + "\n")
+
+    server = http.server.ThreadingHTTPServer((args.host, args.http_port), Handler)
+    print(f"Backend simulado en http://{args.host}:{args.http_port}/audio "
+          f"({len(backend.turns)} turnos, velocidad {args.speed})")
+    server.serve_forever()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    p = sub.add_parser("summary", help="resumen de la traza")
+    p.add_argument("trace")
+    p.set_defaults(func=cmd_summary)
+
+    p = sub.add_parser("link", help="reenviar el enlace por puerto serie")
+    p.add_argument("trace")
+    p.add_argument("--port", required=True)
+    p.add_argument("--node", type=int, default=1, help="nodo de captura (1, 2, ...)")
+    p.add_argument("--baud", type=int, default=921600)
+    p.add_argument("--speed", choices=["recorded", "max"], default="recorded")
+    p.set_defaults(func=cmd_link)
+
+    p = sub.add_parser("serve", help="backend simulado con los resultados grabados")
+    p.add_argument("trace")
+    p.add_argument("--host", default="0.0.0.0")
+    p.add_argument("--http-port", type=int, default=8000)
+    p.add_argument("--speed", choices=["recorded", "max"], default="recorded")
+    p.set_defaults(func=cmd_serve)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()